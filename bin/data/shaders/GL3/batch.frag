@@ -0,0 +1,113 @@
+#version 150
+
+// the source, decoded as in mask.frag
+uniform sampler2DRect tex0;
+
+// the masks of all instances
+uniform sampler2DArray maskTex;
+
+// converts pixel coordinates to maskTex coordinates
+uniform vec2 maskScale;
+
+// the chroma planes of planar yuv frames
+uniform sampler2DRect uvTex;
+uniform sampler2DRect vTex;
+
+// block compressed frames, sampled with normalized coordinates
+uniform sampler2D compressedTex;
+
+// converts pixel coordinates to compressedTex coordinates
+uniform vec2 compressedScale;
+
+// the frame layout: 0 = rgb, 1 = nv12, 2 = i420, 3 = compressed rgb,
+// 4 = compressed scaled ycocg
+uniform int pixelFormat;
+
+// the yuv to rgb matrix: 0 = bt601, 1 = bt709
+uniform int colorMatrix;
+
+// the size of the chroma planes relative to tex0
+uniform vec2 chromaScale;
+
+// maps full size pixel coordinates to tex0 when the frame is downscaled
+uniform vec2 sourceScale;
+
+// these come from the vertex shader
+in vec2 texCoordVarying;
+flat in float maskSlice;
+flat in float opacity;
+
+// this is the output of the fragment shader
+out vec4 outputColor;
+
+// video range yuv to rgb, column major
+const mat3 bt601 = mat3(1.164,  1.164, 1.164,
+                        0.0,   -0.392, 2.017,
+                        1.596, -0.813, 0.0);
+
+const mat3 bt709 = mat3(1.164,  1.164, 1.164,
+                        0.0,   -0.213, 2.112,
+                        1.793, -0.533, 0.0);
+
+// keep in sync with getSource() in mask.frag
+vec3 getSource()
+{
+    vec2 sourceCoord = texCoordVarying * sourceScale;
+
+    if (pixelFormat == 0)
+    {
+        return texture(tex0, sourceCoord).rgb;
+    }
+
+    if (pixelFormat == 3)
+    {
+        return texture(compressedTex, sourceCoord * compressedScale).rgb;
+    }
+
+    if (pixelFormat == 4)
+    {
+        vec4 cocgsy = texture(compressedTex, sourceCoord * compressedScale);
+        cocgsy -= vec4(0.50196078, 0.50196078, 0.0, 0.0);
+
+        float scale = cocgsy.z * (255.0 / 8.0) + 1.0;
+        float co = cocgsy.x / scale;
+        float cg = cocgsy.y / scale;
+        float y = cocgsy.w;
+
+        return vec3(y + co - cg, y + cg, y - co - cg);
+    }
+
+    vec2 chromaCoord = sourceCoord * chromaScale;
+
+    float y = texture(tex0, sourceCoord).r;
+    vec2 uv;
+
+    if (pixelFormat == 1)
+    {
+        uv = texture(uvTex, chromaCoord).rg;
+    }
+    else
+    {
+        uv = vec2(texture(uvTex, chromaCoord).r, texture(vTex, chromaCoord).r);
+    }
+
+    vec3 yuv = vec3(y - 0.0625, uv - 0.5);
+
+    return clamp((colorMatrix == 1 ? bt709 : bt601) * yuv, 0.0, 1.0);
+}
+
+void main()
+{
+    // get rgb from tex0, converting from yuv if needed
+    vec3 src = getSource();
+
+    // get alpha from the mask slice, layers without a mask have no slice
+    float mask = 1.0;
+
+    if (maskSlice >= 0.0)
+    {
+        mask = texture(maskTex, vec3(texCoordVarying * maskScale, maskSlice)).r;
+    }
+
+    outputColor = vec4(src, mask * opacity);
+}
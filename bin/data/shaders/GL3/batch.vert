@@ -0,0 +1,36 @@
+#version 150
+
+// these come from the programmable pipeline
+uniform mat4 modelViewProjectionMatrix;
+
+// per instance: four warp matrix columns, then the mask slice and opacity
+uniform samplerBuffer instanceTex;
+
+in vec4 position;
+in vec2 texcoord;
+
+// texture coordinates are sent to fragment shader
+out vec2 texCoordVarying;
+
+// the mask slice, negative for no mask
+flat out float maskSlice;
+
+// the layer opacity
+flat out float opacity;
+
+void main()
+{
+    int base = gl_InstanceID * 5;
+
+    mat4 warp = mat4(texelFetch(instanceTex, base),
+                     texelFetch(instanceTex, base + 1),
+                     texelFetch(instanceTex, base + 2),
+                     texelFetch(instanceTex, base + 3));
+
+    vec4 attributes = texelFetch(instanceTex, base + 4);
+
+    texCoordVarying = texcoord;
+    maskSlice = attributes.x;
+    opacity = attributes.y;
+    gl_Position = modelViewProjectionMatrix * warp * position;
+}
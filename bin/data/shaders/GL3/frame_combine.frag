@@ -1,9 +1,17 @@
 #version 150
 
-// these are our textures
+// the painted mask, drawn by the layer
 uniform sampler2DRect tex0;
+
+// the accumulated mask of the previous frame
 uniform sampler2DRect frameTex;
 
+// the part of the previous mask kept this frame
+uniform float retention;
+
+// the part of the painted mask added this frame
+uniform float growth;
+
 // this comes from the vertex shader
 in vec2 texCoordVarying;
 
@@ -12,11 +20,8 @@ out vec4 outputColor;
 
 void main()
 {
-    // get rgb from tex0
-    float maskR = texture(tex0, texCoordVarying).r;
-    float frameR = texture(frameTex, texCoordVarying).r;
-    maskR = maskR + frameR;
-    maskR = clamp(maskR, 0, 255);
-    vec3 brightness = vec3(maskR);
-    outputColor = vec4(brightness, 255);
-}
\ No newline at end of file
+    float mask = texture(tex0, texCoordVarying).r;
+    float frame = texture(frameTex, texCoordVarying).r;
+    float value = clamp(frame * retention + mask * growth, 0.0, 1.0);
+    outputColor = vec4(vec3(value), 1.0);
+}
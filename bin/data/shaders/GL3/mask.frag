@@ -4,20 +4,138 @@
 uniform sampler2DRect tex0;
 uniform sampler2DRect maskTex;
 
+// the chroma planes of planar yuv frames
+uniform sampler2DRect uvTex;
+uniform sampler2DRect vTex;
+
+// block compressed frames, sampled with normalized coordinates
+uniform sampler2D compressedTex;
+
+// converts pixel coordinates to compressedTex coordinates
+uniform vec2 compressedScale;
+
+// the frame layout: 0 = rgb, 1 = nv12, 2 = i420, 3 = compressed rgb,
+// 4 = compressed scaled ycocg
+uniform int pixelFormat;
+
+// the yuv to rgb matrix: 0 = bt601, 1 = bt709
+uniform int colorMatrix;
+
+// the size of the chroma planes relative to tex0
+uniform vec2 chromaScale;
+
+// maps full size pixel coordinates to tex0 when the frame is downscaled
+uniform vec2 sourceScale;
+
+// the layer opacity
+uniform float opacity;
+
+// colour correction, skipped when 0
+uniform int gradeEnabled;
+
+// input black, input white, output black, output white
+uniform vec4 levels;
+uniform float gamma;
+uniform float contrast;
+uniform float brightness;
+
+// the 3d lookup table, applied after colour correction when lutEnabled is 1
+uniform sampler3D lutTex;
+uniform int lutEnabled;
+
+// maps a colour onto the texel centres of lutTex
+uniform vec3 lutScale;
+uniform vec3 lutOffset;
+
 // this comes from the vertex shader
 in vec2 texCoordVarying;
 
 // this is the output of the fragment shader
 out vec4 outputColor;
 
+// video range yuv to rgb, column major
+const mat3 bt601 = mat3(1.164,  1.164, 1.164,
+                        0.0,   -0.392, 2.017,
+                        1.596, -0.813, 0.0);
+
+const mat3 bt709 = mat3(1.164,  1.164, 1.164,
+                        0.0,   -0.213, 2.112,
+                        1.793, -0.533, 0.0);
+
+// keep in sync with getSource() in batch.frag
+vec3 getSource()
+{
+    vec2 sourceCoord = texCoordVarying * sourceScale;
+
+    if (pixelFormat == 0)
+    {
+        return texture(tex0, sourceCoord).rgb;
+    }
+
+    if (pixelFormat == 3)
+    {
+        return texture(compressedTex, sourceCoord * compressedScale).rgb;
+    }
+
+    if (pixelFormat == 4)
+    {
+        vec4 cocgsy = texture(compressedTex, sourceCoord * compressedScale);
+        cocgsy -= vec4(0.50196078, 0.50196078, 0.0, 0.0);
+
+        float scale = cocgsy.z * (255.0 / 8.0) + 1.0;
+        float co = cocgsy.x / scale;
+        float cg = cocgsy.y / scale;
+        float y = cocgsy.w;
+
+        return vec3(y + co - cg, y + cg, y - co - cg);
+    }
+
+    vec2 chromaCoord = sourceCoord * chromaScale;
+
+    float y = texture(tex0, sourceCoord).r;
+    vec2 uv;
+
+    if (pixelFormat == 1)
+    {
+        uv = texture(uvTex, chromaCoord).rg;
+    }
+    else
+    {
+        uv = vec2(texture(uvTex, chromaCoord).r, texture(vTex, chromaCoord).r);
+    }
+
+    vec3 yuv = vec3(y - 0.0625, uv - 0.5);
+
+    return clamp((colorMatrix == 1 ? bt709 : bt601) * yuv, 0.0, 1.0);
+}
+
+vec3 grade(vec3 color)
+{
+    if (gradeEnabled == 1)
+    {
+        color = clamp((color - levels.x) / (levels.y - levels.x), 0.0, 1.0);
+        color = pow(color, vec3(1.0 / gamma));
+        color = mix(vec3(levels.z), vec3(levels.w), color);
+        color = (color - 0.5) * contrast + 0.5 + brightness;
+        color = clamp(color, 0.0, 1.0);
+    }
+
+    if (lutEnabled == 1)
+    {
+        color = texture(lutTex, color * lutScale + lutOffset).rgb;
+    }
+
+    return color;
+}
+
 void main()
 {
-    // get rgb from tex0
-    vec3 src = texture(tex0, texCoordVarying).rgb;
+    // get rgb from tex0, converting from yuv if needed, then colour correct
+    vec3 src = grade(getSource());
 
     // get alpha from mask
     float mask = texture(maskTex, texCoordVarying).r;
     
-    //mix the rgb from tex0 with the alpha of the mask
-    outputColor = vec4(src , mask);
-}
\ No newline at end of file
+    //mix the rgb from tex0 with the alpha of the mask and the layer opacity
+    outputColor = vec4(src , mask * opacity);
+}
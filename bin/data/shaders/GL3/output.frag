@@ -0,0 +1,63 @@
+#version 150
+
+// the composited canvas
+uniform sampler2DRect tex0;
+
+// the presented region of the canvas: x, y, width, height in pixels
+uniform vec4 crop;
+
+// the blend zone widths in canvas pixels: left, right, top, bottom
+uniform vec4 blendWidth;
+
+// the projector gamma the ramps are corrected for
+uniform float blendGamma;
+
+// the steepness of the ramps, 1 is linear
+uniform float blendCurve;
+
+// the ramp value at the middle of a blend zone, 0.5 for matching projectors
+uniform float blendLuminance;
+
+// this comes from the vertex shader
+in vec2 texCoordVarying;
+
+// this is the output of the fragment shader
+out vec4 outputColor;
+
+// the blend ramp for a position across a blend zone, 0 at the outer edge
+float ramp(float x)
+{
+    x = clamp(x, 0.0, 1.0);
+
+    float value;
+
+    if (x < 0.5)
+    {
+        value = blendLuminance * pow(2.0 * x, blendCurve);
+    }
+    else
+    {
+        value = 1.0 - (1.0 - blendLuminance) * pow(2.0 * (1.0 - x), blendCurve);
+    }
+
+    // light adds up linearly, so undo the projector gamma
+    return pow(value, 1.0 / blendGamma);
+}
+
+// the blend factor for a distance from an edge of the crop
+float edge(float distance, float width)
+{
+    return width > 0.0 ? ramp(distance / width) : 1.0;
+}
+
+void main()
+{
+    vec2 position = texCoordVarying - crop.xy;
+
+    float blend = edge(position.x, blendWidth.x) *
+                  edge(crop.z - position.x, blendWidth.y) *
+                  edge(position.y, blendWidth.z) *
+                  edge(crop.w - position.y, blendWidth.w);
+
+    outputColor = vec4(texture(tex0, texCoordVarying).rgb * blend, 1.0);
+}
@@ -0,0 +1,266 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cmath>
+
+
+namespace Kibio {
+
+
+/// \brief A lock free ring of timestamped frames, decoded ahead by one
+/// decoder thread and presented by the render thread.
+///
+/// Every frame is tagged with the seek generation it was decoded in. A seek
+/// only bumps the generation, the decoder thread restarts at the seek time
+/// when it sees the new generation and the render thread discards frames of
+/// older generations. Frames are released back to the decoder thread once
+/// they are late, and the current frame is held until the next is due.
+///
+/// \tparam Frame The decoded frame data, reused between frames.
+/// \tparam Size The number of frames decoded ahead.
+template <typename Frame, std::size_t Size>
+class FrameRing
+{
+public:
+    /// \brief Create an empty FrameRing.
+    FrameRing():
+        _writeIndex(0),
+        _readIndex(0),
+        _releaseIndex(0),
+        _generation(0),
+        _writerGeneration(0),
+        _seekTime(0)
+    {
+    }
+
+    /// \brief Empty the ring and forget seeks.
+    ///
+    /// Must only be called while the decoder thread is stopped.
+    void reset()
+    {
+        _writeIndex = 0;
+        _readIndex = 0;
+        _releaseIndex = 0;
+        _generation = 0;
+        _writerGeneration = 0;
+        _seekTime = 0;
+    }
+
+    /// \brief Request the decoder thread to restart at a time.
+    /// \param time The time in seconds to seek to.
+    void seek(double time)
+    {
+        _seekTime.store(time, std::memory_order_relaxed);
+        _generation.fetch_add(1, std::memory_order_release);
+    }
+
+    /// \returns the time of the last seek in seconds.
+    double getSeekTime() const
+    {
+        return _seekTime.load(std::memory_order_relaxed);
+    }
+
+    /// \brief Get the last frame due at a playback time.
+    ///
+    /// Earlier due frames and frames decoded before the last seek are
+    /// dropped. The returned frame stays valid until release() is called,
+    /// which must follow every call.
+    ///
+    /// \param time The playback time in seconds.
+    /// \param duration The video duration in seconds, or 0 if unknown.
+    /// \returns the due frame or nullptr if no new frame is due.
+    const Frame* acquire(double time, double duration)
+    {
+        uint64_t generation = _generation.load(std::memory_order_acquire);
+        std::size_t readIndex = _readIndex.load(std::memory_order_relaxed);
+        std::size_t writeIndex = _writeIndex.load(std::memory_order_acquire);
+
+        const Frame* dueFrame = nullptr;
+
+        _releaseIndex = readIndex;
+
+        for (std::size_t i = readIndex; i != writeIndex; ++i)
+        {
+            const Slot& slot = _slots[i % Size];
+
+            if (slot.generation != generation)
+            {
+                // Decoded before the last seek.
+                _releaseIndex = i + 1;
+            }
+            else if (isDue(slot.timestamp, time, duration))
+            {
+                // Any earlier due frame is dropped.
+                dueFrame = &slot.frame;
+                _releaseIndex = i + 1;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        return dueFrame;
+    }
+
+    /// \brief Hand the frames passed by the last acquire() back to the
+    /// decoder thread.
+    void release()
+    {
+        _readIndex.store(_releaseIndex, std::memory_order_release);
+    }
+
+    /// \brief Discard frames decoded before the last seek.
+    /// \returns true if a frame decoded after the last seek is ready.
+    bool preroll()
+    {
+        uint64_t generation = _generation.load(std::memory_order_acquire);
+        std::size_t readIndex = _readIndex.load(std::memory_order_relaxed);
+        std::size_t writeIndex = _writeIndex.load(std::memory_order_acquire);
+
+        while (readIndex != writeIndex && _slots[readIndex % Size].generation != generation)
+        {
+            ++readIndex;
+        }
+
+        _readIndex.store(readIndex, std::memory_order_release);
+
+        return readIndex != writeIndex;
+    }
+
+    /// \brief Check for a seek on the decoder thread.
+    /// \param time Set to the seek time if there was a seek.
+    /// \returns true if the decoder must restart at time.
+    bool pollSeek(double& time)
+    {
+        uint64_t generation = _generation.load(std::memory_order_acquire);
+
+        if (generation == _writerGeneration)
+        {
+            return false;
+        }
+
+        _writerGeneration = generation;
+        time = _seekTime.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /// \brief Get the next free frame on the decoder thread.
+    /// \returns the frame to decode into, or nullptr if the ring is full.
+    Frame* getWriteFrame()
+    {
+        std::size_t writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        std::size_t readIndex = _readIndex.load(std::memory_order_acquire);
+
+        if (writeIndex - readIndex >= Size)
+        {
+            return nullptr;
+        }
+
+        return &_slots[writeIndex % Size].frame;
+    }
+
+    /// \brief Publish the frame from getWriteFrame() to the render thread.
+    /// \param timestamp The presentation time of the frame in seconds.
+    void commit(double timestamp)
+    {
+        std::size_t writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        Slot& slot = _slots[writeIndex % Size];
+        slot.timestamp = timestamp;
+        slot.generation = _writerGeneration;
+        _writeIndex.store(writeIndex + 1, std::memory_order_release);
+    }
+
+    /// \brief Check if a frame is due, taking looping into account.
+    /// \param timestamp The frame timestamp in seconds.
+    /// \param time The playback time in seconds.
+    /// \param duration The video duration in seconds, or 0 if unknown.
+    /// \returns true if the frame should be presented at time.
+    static bool isDue(double timestamp, double time, double duration)
+    {
+        if (duration <= 0)
+        {
+            return timestamp <= time;
+        }
+
+        double delta = std::fmod(time, duration) - timestamp;
+
+        if (delta < 0)
+        {
+            delta += duration;
+        }
+
+        // Frames more than half a loop ahead are treated as late frames from
+        // before the loop point.
+        return delta < duration * 0.5;
+    }
+
+private:
+    FrameRing(const FrameRing&);
+    FrameRing& operator = (const FrameRing&);
+
+    /// \brief A frame with its schedule.
+    struct Slot
+    {
+        /// \brief The decoded frame.
+        Frame frame;
+
+        /// \brief The presentation time in seconds.
+        double timestamp;
+
+        /// \brief The seek generation the frame was decoded in.
+        uint64_t generation;
+    };
+
+    /// \brief The frames.
+    Slot _slots[Size];
+
+    /// \brief The total number of frames written by the decoder thread.
+    std::atomic<std::size_t> _writeIndex;
+
+    /// \brief The total number of frames released by the render thread.
+    std::atomic<std::size_t> _readIndex;
+
+    /// \brief The read index to store on release(), render thread only.
+    std::size_t _releaseIndex;
+
+    /// \brief The requested seek generation.
+    std::atomic<uint64_t> _generation;
+
+    /// \brief The generation being decoded, decoder thread only.
+    uint64_t _writerGeneration;
+
+    /// \brief The requested seek time in seconds.
+    std::atomic<double> _seekTime;
+
+};
+
+
+} // namespace Kibio
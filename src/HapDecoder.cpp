@@ -0,0 +1,910 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "HapDecoder.h"
+#include "ofLog.h"
+
+
+namespace Kibio {
+
+
+HapDecoder::Track::Track():
+    codec(0),
+    width(0),
+    height(0),
+    timeScale(0),
+    sampleDuration(0),
+    sampleSize(0),
+    sampleCount(0),
+    fileSize(0)
+{
+}
+
+
+HapDecoder::HapDecoder():
+    _glInternalFormat(0),
+    _sectionFormat(0),
+    _frameSize(0),
+    _textureWidth(0),
+    _textureHeight(0),
+    _isYCoCg(false),
+    _isLoaded(false),
+    _isFrameNew(false),
+    _width(0),
+    _height(0),
+    _duration(0),
+    _frameRate(0)
+{
+}
+
+
+HapDecoder::~HapDecoder()
+{
+    close();
+}
+
+
+bool HapDecoder::load(const std::string& path)
+{
+    close();
+
+    _file.open(path.c_str(), std::ios::binary);
+
+    _track = Track();
+
+    if (!_file || !readTrack(_file, _track))
+    {
+        ofLogError("HapDecoder::load") << "No HAP video track found: " << path;
+        _file.close();
+        return false;
+    }
+
+    std::size_t bytesPerBlock = 16;
+
+    switch (_track.codec)
+    {
+        case CODEC_HAP:
+            _glInternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            _sectionFormat = 0x0B;
+            bytesPerBlock = 8;
+            break;
+        case CODEC_HAP_ALPHA:
+            _glInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            _sectionFormat = 0x0E;
+            break;
+        case CODEC_HAP_Q:
+            _glInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            _sectionFormat = 0x0F;
+            break;
+        case CODEC_HAP_R:
+            _glInternalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+            _sectionFormat = 0x0C;
+            break;
+    }
+
+    _isYCoCg = _track.codec == CODEC_HAP_Q;
+
+    _width = _track.width;
+    _height = _track.height;
+
+    // Frames are stored as whole 4 x 4 blocks.
+    _textureWidth = (_track.width + 3) / 4 * 4;
+    _textureHeight = (_track.height + 3) / 4 * 4;
+    _frameSize = (_textureWidth / 4) * (_textureHeight / 4) * bytesPerBlock;
+
+    if (_track.timeScale > 0 && _track.sampleDuration > 0)
+    {
+        _frameRate = double(_track.timeScale) / _track.sampleDuration;
+    }
+    else
+    {
+        ofLogWarning("HapDecoder::load") << "Unknown frame rate, assuming 30 fps: " << path;
+        _frameRate = 30;
+    }
+
+    _duration = _track.samples.size() / _frameRate;
+
+    _quad.clear();
+    _quad.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
+    _quad.addVertex(ofVec3f(0, 0));
+    _quad.addTexCoord(ofVec2f(0, 0));
+    _quad.addVertex(ofVec3f(_width, 0));
+    _quad.addTexCoord(ofVec2f(_width, 0));
+    _quad.addVertex(ofVec3f(0, _height));
+    _quad.addTexCoord(ofVec2f(0, _height));
+    _quad.addVertex(ofVec3f(_width, _height));
+    _quad.addTexCoord(ofVec2f(_width, _height));
+
+    _frames.reset();
+    _isFrameNew = false;
+    _isLoaded = true;
+
+    startThread();
+
+    return true;
+}
+
+
+void HapDecoder::close()
+{
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+
+    if (_isLoaded)
+    {
+        _file.close();
+        _texture.clear();
+        _isLoaded = false;
+    }
+}
+
+
+bool HapDecoder::isLoaded() const
+{
+    return _isLoaded;
+}
+
+
+void HapDecoder::update(double time)
+{
+    _isFrameNew = false;
+
+    if (!_isLoaded)
+    {
+        return;
+    }
+
+    const std::vector<unsigned char>* dueFrame = _frames.acquire(time, _duration);
+
+    if (dueFrame)
+    {
+        _uploader.uploadCompressed(dueFrame->data(),
+                                   _frameSize,
+                                   _textureWidth,
+                                   _textureHeight,
+                                   _glInternalFormat,
+                                   _texture);
+        _isFrameNew = true;
+    }
+
+    _frames.release();
+}
+
+
+bool HapDecoder::isFrameNew() const
+{
+    return _isFrameNew;
+}
+
+
+void HapDecoder::seek(double time)
+{
+    _frames.seek(time);
+}
+
+
+bool HapDecoder::preroll()
+{
+    _isFrameNew = false;
+
+    return _frames.preroll();
+}
+
+
+float HapDecoder::getWidth() const
+{
+    return _width;
+}
+
+
+float HapDecoder::getHeight() const
+{
+    return _height;
+}
+
+
+double HapDecoder::getDuration() const
+{
+    return _duration;
+}
+
+
+double HapDecoder::getFrameRate() const
+{
+    return _frameRate;
+}
+
+
+const TextureUploader::Stats& HapDecoder::getUploadStats() const
+{
+    return _uploader.getStats();
+}
+
+
+void HapDecoder::setShaderUniforms(const ofShader& shader) const
+{
+    if (_texture.isAllocated())
+    {
+        shader.setUniformTexture("compressedTex", _texture, 4);
+    }
+
+    shader.setUniform1i("pixelFormat", _isYCoCg ? 4 : 3);
+    shader.setUniform2f("sourceScale", 1, 1);
+    shader.setUniform2f("compressedScale", 1.0f / _textureWidth, 1.0f / _textureHeight);
+}
+
+
+void HapDecoder::draw(float x, float y) const
+{
+    if (_texture.isAllocated())
+    {
+        ofPushMatrix();
+        ofTranslate(x, y);
+        _quad.draw();
+        ofPopMatrix();
+    }
+}
+
+
+bool HapDecoder::canLoad(const std::string& path)
+{
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    Track track;
+    return stream && readTrack(stream, track);
+}
+
+
+void HapDecoder::threadedFunction()
+{
+    std::size_t frameIndex = 0;
+    std::vector<unsigned char> sample;
+
+    while (isThreadRunning())
+    {
+        double seekTime = 0;
+
+        if (_frames.pollSeek(seekTime))
+        {
+            // Every HAP frame is a key frame, so seeking is just indexing.
+            frameIndex = static_cast<std::size_t>(seekTime * _frameRate) % _track.samples.size();
+        }
+
+        std::vector<unsigned char>* blocks = _frames.getWriteFrame();
+
+        if (!blocks)
+        {
+            sleep(1);
+            continue;
+        }
+
+        const Sample& location = _track.samples[frameIndex];
+
+        sample.resize(location.size);
+        _file.seekg(location.offset);
+        _file.read(reinterpret_cast<char*>(sample.data()), location.size);
+
+        if (_file && decodeFrame(sample.data(), sample.size(), *blocks))
+        {
+            _frames.commit(frameIndex / _frameRate);
+        }
+        else
+        {
+            ofLogError("HapDecoder::threadedFunction") << "Unable to decode frame " << frameIndex;
+            _file.clear();
+        }
+
+        frameIndex = (frameIndex + 1) % _track.samples.size();
+    }
+}
+
+
+bool HapDecoder::decodeFrame(const unsigned char* data,
+                             std::size_t size,
+                             std::vector<unsigned char>& blocks) const
+{
+    std::size_t headerSize = 0;
+    std::size_t sectionSize = 0;
+    unsigned int type = 0;
+
+    if (!readSectionHeader(data, size, headerSize, sectionSize, type) ||
+        (type & 0x0F) != _sectionFormat)
+    {
+        return false;
+    }
+
+    const unsigned char* section = data + headerSize;
+
+    blocks.clear();
+
+    switch (type & 0xF0)
+    {
+        case 0xA0:
+            blocks.assign(section, section + sectionSize);
+            break;
+        case 0xB0:
+            if (!decompressSnappy(section, sectionSize, _frameSize, blocks))
+            {
+                return false;
+            }
+            break;
+        case 0xC0:
+            if (!decodeChunks(section, sectionSize, blocks))
+            {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    return blocks.size() == _frameSize;
+}
+
+
+bool HapDecoder::decodeChunks(const unsigned char* data,
+                              std::size_t size,
+                              std::vector<unsigned char>& blocks) const
+{
+    std::size_t headerSize = 0;
+    std::size_t instructionsSize = 0;
+    unsigned int type = 0;
+
+    // The decode instructions container comes first.
+    if (!readSectionHeader(data, size, headerSize, instructionsSize, type) || type != 0x01)
+    {
+        return false;
+    }
+
+    const unsigned char* instructions = data + headerSize;
+
+    std::vector<unsigned char> compressors;
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> offsets;
+
+    std::size_t position = 0;
+
+    while (position < instructionsSize)
+    {
+        std::size_t instructionHeaderSize = 0;
+        std::size_t instructionSize = 0;
+
+        if (!readSectionHeader(instructions + position,
+                               instructionsSize - position,
+                               instructionHeaderSize,
+                               instructionSize,
+                               type))
+        {
+            return false;
+        }
+
+        const unsigned char* instruction = instructions + position + instructionHeaderSize;
+
+        switch (type)
+        {
+            case 0x02:
+                compressors.assign(instruction, instruction + instructionSize);
+                break;
+            case 0x03:
+                for (std::size_t i = 0; i + 4 <= instructionSize; i += 4)
+                {
+                    sizes.push_back(readUInt32LE(instruction + i));
+                }
+                break;
+            case 0x04:
+                for (std::size_t i = 0; i + 4 <= instructionSize; i += 4)
+                {
+                    offsets.push_back(readUInt32LE(instruction + i));
+                }
+                break;
+        }
+
+        position += instructionHeaderSize + instructionSize;
+    }
+
+    if (compressors.empty() ||
+        compressors.size() != sizes.size() ||
+        (!offsets.empty() && offsets.size() != sizes.size()))
+    {
+        return false;
+    }
+
+    const unsigned char* chunks = instructions + instructionsSize;
+    std::size_t chunksSize = size - headerSize - instructionsSize;
+    std::size_t offset = 0;
+
+    for (std::size_t i = 0; i < compressors.size(); ++i)
+    {
+        std::size_t chunkOffset = offsets.empty() ? offset : offsets[i];
+
+        if (chunkOffset + sizes[i] > chunksSize)
+        {
+            return false;
+        }
+
+        const unsigned char* chunk = chunks + chunkOffset;
+
+        if (compressors[i] == 0x0A)
+        {
+            // Keep blocks within the frame, so later chunks can rely on it.
+            if (blocks.size() + sizes[i] > _frameSize)
+            {
+                return false;
+            }
+
+            blocks.insert(blocks.end(), chunk, chunk + sizes[i]);
+        }
+        else if (compressors[i] != 0x0B ||
+                 !decompressSnappy(chunk, sizes[i], _frameSize - blocks.size(), blocks))
+        {
+            return false;
+        }
+
+        offset += sizes[i];
+    }
+
+    return true;
+}
+
+
+bool HapDecoder::readTrack(std::istream& stream, Track& track)
+{
+    unsigned char header[16];
+
+    // Atom sizes are untrusted, check them against the file length.
+    std::streampos start = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    uint64_t fileSize = uint64_t(stream.tellg());
+    stream.seekg(start);
+
+    while (stream.read(reinterpret_cast<char*>(header), 8))
+    {
+        uint64_t atomSize = readUInt32(header);
+        std::string atomType(reinterpret_cast<const char*>(header + 4), 4);
+        uint64_t headerSize = 8;
+
+        if (atomSize == 1)
+        {
+            if (!stream.read(reinterpret_cast<char*>(header + 8), 8))
+            {
+                return false;
+            }
+
+            atomSize = readUInt64(header + 8);
+            headerSize = 16;
+        }
+
+        uint64_t remaining = fileSize - uint64_t(stream.tellg());
+
+        if (atomSize == 0)
+        {
+            // The atom extends to the end of the file.
+            atomSize = remaining + headerSize;
+        }
+
+        if (atomSize < headerSize || atomSize - headerSize > remaining)
+        {
+            return false;
+        }
+
+        if ("moov" == atomType)
+        {
+            std::vector<unsigned char> atom(atomSize - headerSize);
+
+            if (!stream.read(reinterpret_cast<char*>(atom.data()), atom.size()))
+            {
+                return false;
+            }
+
+            track.fileSize = fileSize;
+            return parseAtoms(atom.data(), atom.size(), track);
+        }
+
+        stream.seekg(atomSize - headerSize, std::ios::cur);
+    }
+
+    return false;
+}
+
+
+bool HapDecoder::parseAtoms(const unsigned char* data, std::size_t size, Track& track)
+{
+    std::size_t position = 0;
+
+    while (position + 8 <= size)
+    {
+        uint64_t atomSize = readUInt32(data + position);
+        std::string atomType(reinterpret_cast<const char*>(data + position + 4), 4);
+        std::size_t headerSize = 8;
+
+        if (atomSize == 1 && position + 16 <= size)
+        {
+            atomSize = readUInt64(data + position + 8);
+            headerSize = 16;
+        }
+        else if (atomSize == 0)
+        {
+            atomSize = size - position;
+        }
+
+        if (atomSize < headerSize || atomSize > size - position)
+        {
+            return false;
+        }
+
+        const unsigned char* atom = data + position + headerSize;
+        std::size_t atomDataSize = atomSize - headerSize;
+
+        if ("trak" == atomType)
+        {
+            Track candidate;
+            candidate.fileSize = track.fileSize;
+
+            if (parseAtoms(atom, atomDataSize, candidate))
+            {
+                track = candidate;
+                return true;
+            }
+        }
+        else if ("mdia" == atomType || "minf" == atomType || "stbl" == atomType)
+        {
+            if (parseAtoms(atom, atomDataSize, track))
+            {
+                return true;
+            }
+        }
+        else if ("mdhd" == atomType && atomDataSize >= 24)
+        {
+            // Version 1 uses 64 bit creation and modification times.
+            track.timeScale = readUInt32(atom + (atom[0] == 1 ? 20 : 12));
+        }
+        else if ("stsd" == atomType && atomDataSize >= 44)
+        {
+            track.codec = readUInt32(atom + 12);
+            track.width = (atom[40] << 8) | atom[41];
+            track.height = (atom[42] << 8) | atom[43];
+        }
+        else if (!isSupported(track.codec))
+        {
+            // The sample description comes first, so the sample tables of
+            // other tracks are skipped. Audio tracks have one per sample.
+        }
+        else if ("stts" == atomType && atomDataSize >= 16)
+        {
+            // Assume a constant frame rate.
+            track.sampleDuration = readUInt32(atom + 12);
+        }
+        else if ("stsc" == atomType && atomDataSize >= 8)
+        {
+            uint32_t count = readUInt32(atom + 4);
+
+            for (uint32_t i = 0; i < count && 8 + (i + 1) * 12 <= atomDataSize; ++i)
+            {
+                ChunkRun run = { readUInt32(atom + 8 + i * 12), readUInt32(atom + 12 + i * 12) };
+                track.chunkRuns.push_back(run);
+            }
+        }
+        else if ("stsz" == atomType && atomDataSize >= 12)
+        {
+            uint32_t sampleSize = readUInt32(atom + 4);
+            uint32_t count = readUInt32(atom + 8);
+
+            if (sampleSize != 0)
+            {
+                track.sampleSize = sampleSize;
+                track.sampleCount = count;
+            }
+            else
+            {
+                for (uint32_t i = 0; i < count && 12 + (i + 1) * 4 <= atomDataSize; ++i)
+                {
+                    track.sampleSizes.push_back(readUInt32(atom + 12 + i * 4));
+                }
+            }
+        }
+        else if ("stco" == atomType && atomDataSize >= 8)
+        {
+            uint32_t count = readUInt32(atom + 4);
+
+            for (uint32_t i = 0; i < count && 8 + (i + 1) * 4 <= atomDataSize; ++i)
+            {
+                track.chunkOffsets.push_back(readUInt32(atom + 8 + i * 4));
+            }
+        }
+        else if ("co64" == atomType && atomDataSize >= 8)
+        {
+            uint32_t count = readUInt32(atom + 4);
+
+            for (uint32_t i = 0; i < count && 8 + (i + 1) * 8 <= atomDataSize; ++i)
+            {
+                track.chunkOffsets.push_back(readUInt64(atom + 8 + i * 8));
+            }
+        }
+
+        position += atomSize;
+    }
+
+    // Only a complete sample table of a supported codec makes a track.
+    if (!isSupported(track.codec))
+    {
+        return false;
+    }
+
+    buildSamples(track);
+    return track.width > 0 && track.height > 0 && !track.samples.empty();
+}
+
+
+bool HapDecoder::isSupported(uint32_t codec)
+{
+    switch (codec)
+    {
+        case CODEC_HAP:
+        case CODEC_HAP_ALPHA:
+        case CODEC_HAP_Q:
+        case CODEC_HAP_R:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+void HapDecoder::buildSamples(Track& track)
+{
+    track.samples.clear();
+
+    std::size_t sampleIndex = 0;
+    std::size_t sampleCount = track.sampleSize != 0 ? track.sampleCount : track.sampleSizes.size();
+
+    for (std::size_t i = 0; i < track.chunkRuns.size(); ++i)
+    {
+        const ChunkRun& run = track.chunkRuns[i];
+
+        std::size_t lastChunk = i + 1 < track.chunkRuns.size() ? track.chunkRuns[i + 1].firstChunk : track.chunkOffsets.size() + 1;
+
+        for (std::size_t chunk = run.firstChunk; chunk < lastChunk && chunk <= track.chunkOffsets.size(); ++chunk)
+        {
+            uint64_t offset = track.chunkOffsets[chunk - 1];
+
+            for (uint32_t j = 0; j < run.samplesPerChunk && sampleIndex < sampleCount; ++j)
+            {
+                Sample sample = { offset, track.sampleSize != 0 ? track.sampleSize : track.sampleSizes[sampleIndex] };
+
+                // Counts are untrusted, every sample must lie in the file.
+                if (offset + sample.size > track.fileSize)
+                {
+                    return;
+                }
+
+                track.samples.push_back(sample);
+                offset += sample.size;
+                ++sampleIndex;
+            }
+        }
+    }
+}
+
+
+bool HapDecoder::readSectionHeader(const unsigned char* data,
+                                   std::size_t size,
+                                   std::size_t& headerSize,
+                                   std::size_t& sectionSize,
+                                   unsigned int& type)
+{
+    if (size < 4)
+    {
+        return false;
+    }
+
+    sectionSize = data[0] | (data[1] << 8) | (data[2] << 16);
+    type = data[3];
+    headerSize = 4;
+
+    // A zero size is followed by a 32 bit size.
+    if (sectionSize == 0)
+    {
+        if (size < 8)
+        {
+            return false;
+        }
+
+        sectionSize = readUInt32LE(data + 4);
+        headerSize = 8;
+    }
+
+    return sectionSize <= size - headerSize;
+}
+
+
+bool HapDecoder::decompressSnappy(const unsigned char* data,
+                                  std::size_t size,
+                                  std::size_t maxLength,
+                                  std::vector<unsigned char>& output)
+{
+    std::size_t position = 0;
+    uint64_t length = 0;
+
+    // The uncompressed length is a little endian base 128 varint.
+    for (int shift = 0; ; shift += 7)
+    {
+        if (position >= size || shift > 28)
+        {
+            return false;
+        }
+
+        unsigned char byte = data[position++];
+        length |= uint64_t(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+
+    if (length > maxLength)
+    {
+        return false;
+    }
+
+    std::size_t begin = output.size();
+    std::size_t end = begin + length;
+
+    // Reserve up front so that copies never reallocate.
+    output.reserve(end);
+
+    while (position < size)
+    {
+        unsigned char tag = data[position++];
+        std::size_t copyLength = 0;
+        std::size_t copyOffset = 0;
+
+        switch (tag & 0x03)
+        {
+            case 0x00:
+            {
+                std::size_t literalLength = tag >> 2;
+
+                // Long literals store their length in 1 to 4 extra bytes.
+                if (literalLength >= 60)
+                {
+                    std::size_t bytes = literalLength - 59;
+
+                    if (position + bytes > size)
+                    {
+                        return false;
+                    }
+
+                    literalLength = 0;
+
+                    for (std::size_t i = 0; i < bytes; ++i)
+                    {
+                        literalLength |= std::size_t(data[position + i]) << (8 * i);
+                    }
+
+                    position += bytes;
+                }
+
+                literalLength += 1;
+
+                if (literalLength > size - position || output.size() + literalLength > end)
+                {
+                    return false;
+                }
+
+                output.insert(output.end(), data + position, data + position + literalLength);
+                position += literalLength;
+                continue;
+            }
+            case 0x01:
+                if (position + 1 > size)
+                {
+                    return false;
+                }
+
+                copyLength = 4 + ((tag >> 2) & 0x07);
+                copyOffset = ((tag >> 5) << 8) | data[position];
+                position += 1;
+                break;
+            case 0x02:
+                if (position + 2 > size)
+                {
+                    return false;
+                }
+
+                copyLength = (tag >> 2) + 1;
+                copyOffset = data[position] | (data[position + 1] << 8);
+                position += 2;
+                break;
+            case 0x03:
+                if (position + 4 > size)
+                {
+                    return false;
+                }
+
+                copyLength = (tag >> 2) + 1;
+                copyOffset = readUInt32LE(data + position);
+                position += 4;
+                break;
+        }
+
+        if (copyOffset == 0 ||
+            copyOffset > output.size() - begin ||
+            output.size() + copyLength > end)
+        {
+            return false;
+        }
+
+        std::size_t destination = output.size();
+        output.resize(destination + copyLength);
+
+        unsigned char* to = output.data() + destination;
+        const unsigned char* from = to - copyOffset;
+
+        // Copies may overlap their own output, repeating a pattern.
+        if (copyOffset >= copyLength)
+        {
+            std::memcpy(to, from, copyLength);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < copyLength; ++i)
+            {
+                to[i] = from[i];
+            }
+        }
+    }
+
+    return output.size() == end;
+}
+
+
+uint32_t HapDecoder::readUInt32(const unsigned char* data)
+{
+    return (uint32_t(data[0]) << 24) |
+           (uint32_t(data[1]) << 16) |
+           (uint32_t(data[2]) << 8) |
+           uint32_t(data[3]);
+}
+
+
+uint64_t HapDecoder::readUInt64(const unsigned char* data)
+{
+    return (uint64_t(readUInt32(data)) << 32) | readUInt32(data + 4);
+}
+
+
+uint32_t HapDecoder::readUInt32LE(const unsigned char* data)
+{
+    return uint32_t(data[0]) |
+           (uint32_t(data[1]) << 8) |
+           (uint32_t(data[2]) << 16) |
+           (uint32_t(data[3]) << 24);
+}
+
+
+} // namespace Kibio
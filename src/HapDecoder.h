@@ -0,0 +1,288 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <fstream>
+#include "ofThread.h"
+#include "ofTexture.h"
+#include "ofMesh.h"
+#include "FrameRing.h"
+#include "TextureUploader.h"
+#include "VideoSource.h"
+
+
+namespace Kibio {
+
+
+/// \brief Plays HAP encoded QuickTime movies.
+///
+/// HAP frames are DXT1, DXT5, scaled YCoCg DXT5 or BC7 textures that are
+/// optionally Snappy compressed, either whole or in chunks. The decoder
+/// thread reads and decompresses frames ahead into a FrameRing, and the
+/// render thread uploads the blocks of the due frame straight into a
+/// compressed texture. No pixels are decoded on the CPU.
+///
+/// The texture is a GL_TEXTURE_2D, so frames are sampled by the layer shader
+/// configured with setShaderUniforms(). HAP Q Alpha and HAP Alpha-Only
+/// movies are not supported.
+class HapDecoder: public ofThread, public VideoSource
+{
+public:
+    /// \brief A typedef for a shared decoder.
+    typedef std::shared_ptr<HapDecoder> SharedPtr;
+
+    /// \brief Create a HapDecoder.
+    HapDecoder();
+
+    /// \brief Destroy the HapDecoder, stopping the decoder thread.
+    virtual ~HapDecoder();
+
+    bool load(const std::string& path) override;
+    void close() override;
+    bool isLoaded() const override;
+    void update(double time) override;
+    bool isFrameNew() const override;
+    void seek(double time) override;
+    bool preroll() override;
+    float getWidth() const override;
+    float getHeight() const override;
+    double getDuration() const override;
+    double getFrameRate() const override;
+    const TextureUploader::Stats& getUploadStats() const override;
+    void setShaderUniforms(const ofShader& shader) const override;
+    void draw(float x, float y) const override;
+
+    /// \brief Check if a file is a supported HAP movie.
+    /// \param path The path to the video file.
+    /// \returns true if the file has a supported HAP video track.
+    static bool canLoad(const std::string& path);
+
+    enum
+    {
+        /// \brief The number of frames decompressed ahead.
+        RING_SIZE = 4
+    };
+
+    /// \brief The QuickTime codec identifiers of supported HAP variants.
+    enum Codec
+    {
+        /// \brief HAP, DXT1 RGB.
+        CODEC_HAP = 0x48617031,
+        /// \brief HAP Alpha, DXT5 RGBA.
+        CODEC_HAP_ALPHA = 0x48617035,
+        /// \brief HAP Q, DXT5 scaled YCoCg.
+        CODEC_HAP_Q = 0x48617059,
+        /// \brief HAP R, BC7 RGBA.
+        CODEC_HAP_R = 0x48617037
+    };
+
+protected:
+    void threadedFunction() override;
+
+private:
+    /// \brief The location of a frame in the movie file.
+    struct Sample
+    {
+        /// \brief The byte offset of the frame in the file.
+        uint64_t offset;
+
+        /// \brief The size of the frame in bytes.
+        uint32_t size;
+    };
+
+    /// \brief A run of chunks with the same number of samples.
+    struct ChunkRun
+    {
+        /// \brief The one based index of the first chunk of the run.
+        uint32_t firstChunk;
+
+        /// \brief The number of samples in each chunk of the run.
+        uint32_t samplesPerChunk;
+    };
+
+    /// \brief The video track of a movie.
+    struct Track
+    {
+        Track();
+
+        /// \brief The codec identifier.
+        uint32_t codec;
+
+        /// \brief The frame width in pixels.
+        int width;
+
+        /// \brief The frame height in pixels.
+        int height;
+
+        /// \brief The number of time units per second.
+        uint32_t timeScale;
+
+        /// \brief The duration of each frame in time units.
+        uint32_t sampleDuration;
+
+        /// \brief The sample to chunk table.
+        std::vector<ChunkRun> chunkRuns;
+
+        /// \brief The chunk offset table.
+        std::vector<uint64_t> chunkOffsets;
+
+        /// \brief The sample size table, empty if all samples have the
+        /// same size.
+        std::vector<uint32_t> sampleSizes;
+
+        /// \brief The size of every sample in bytes, or 0 if they differ.
+        uint32_t sampleSize;
+
+        /// \brief The number of samples when they all have the same size.
+        uint32_t sampleCount;
+
+        /// \brief The size of the movie file in bytes.
+        uint64_t fileSize;
+
+        /// \brief The frame locations, built from the tables.
+        std::vector<Sample> samples;
+    };
+
+    /// \brief Decompress a HAP frame into texture blocks.
+    /// \param data The HAP frame.
+    /// \param size The size of the HAP frame in bytes.
+    /// \param blocks The decompressed texture blocks.
+    /// \returns true if the frame was decompressed.
+    bool decodeFrame(const unsigned char* data,
+                     std::size_t size,
+                     std::vector<unsigned char>& blocks) const;
+
+    /// \brief Decompress a chunked HAP frame section into texture blocks.
+    /// \param data The section data.
+    /// \param size The size of the section data in bytes.
+    /// \param blocks The decompressed texture blocks.
+    /// \returns true if all chunks were decompressed.
+    bool decodeChunks(const unsigned char* data,
+                      std::size_t size,
+                      std::vector<unsigned char>& blocks) const;
+
+    /// \brief Find the first supported HAP video track in a movie.
+    /// \param stream The movie file.
+    /// \param track The track to fill.
+    /// \returns true if a track was found.
+    static bool readTrack(std::istream& stream, Track& track);
+
+    /// \brief Parse the atoms of a QuickTime container atom.
+    /// \param data The atom contents.
+    /// \param size The size of the atom contents in bytes.
+    /// \param track The track being parsed.
+    /// \returns true if a supported HAP track was found.
+    static bool parseAtoms(const unsigned char* data, std::size_t size, Track& track);
+
+    /// \param codec The QuickTime codec identifier.
+    /// \returns true if the codec is a supported HAP variant.
+    static bool isSupported(uint32_t codec);
+
+    /// \brief Build the frame locations from the sample tables.
+    /// \param track The track to build the frame locations for.
+    static void buildSamples(Track& track);
+
+    /// \brief Read a HAP section header.
+    /// \param data The section.
+    /// \param size The available bytes.
+    /// \param headerSize The size of the header in bytes.
+    /// \param sectionSize The size of the section data in bytes.
+    /// \param type The section type.
+    /// \returns true if the section fits in the available bytes.
+    static bool readSectionHeader(const unsigned char* data,
+                                  std::size_t size,
+                                  std::size_t& headerSize,
+                                  std::size_t& sectionSize,
+                                  unsigned int& type);
+
+    /// \brief Decompress a Snappy block, appending to the output.
+    /// \param data The compressed block.
+    /// \param size The size of the compressed block in bytes.
+    /// \param maxLength The largest acceptable uncompressed size in bytes.
+    /// \param output The output to append to.
+    /// \returns true if the block was decompressed.
+    static bool decompressSnappy(const unsigned char* data,
+                                 std::size_t size,
+                                 std::size_t maxLength,
+                                 std::vector<unsigned char>& output);
+
+    /// \returns the big endian 32 bit integer at data.
+    static uint32_t readUInt32(const unsigned char* data);
+
+    /// \returns the big endian 64 bit integer at data.
+    static uint64_t readUInt64(const unsigned char* data);
+
+    /// \returns the little endian 32 bit integer at data.
+    static uint32_t readUInt32LE(const unsigned char* data);
+
+    /// \brief The movie file, only read by the decoder thread once loaded.
+    std::ifstream _file;
+
+    /// \brief The video track.
+    Track _track;
+
+    /// \brief The compressed texture holding the current frame.
+    ofTexture _texture;
+
+    /// \brief A quad with texture coordinates in pixels.
+    ofMesh _quad;
+
+    /// \brief Streams due frames into the texture.
+    TextureUploader _uploader;
+
+    /// \brief The compressed texture blocks of the frames decoded ahead.
+    FrameRing<std::vector<unsigned char>, RING_SIZE> _frames;
+
+    /// \brief The compressed GL internal format of the texture.
+    int _glInternalFormat;
+
+    /// \brief The HAP section format of the frames.
+    unsigned int _sectionFormat;
+
+    /// \brief The size of the texture blocks of a frame in bytes.
+    std::size_t _frameSize;
+
+    /// \brief The texture width, rounded up to whole blocks.
+    int _textureWidth;
+
+    /// \brief The texture height, rounded up to whole blocks.
+    int _textureHeight;
+
+    bool _isYCoCg;
+    bool _isLoaded;
+    bool _isFrameNew;
+
+    float _width;
+    float _height;
+    double _duration;
+    double _frameRate;
+
+};
+
+
+} // namespace Kibio
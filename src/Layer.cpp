@@ -31,20 +31,73 @@
 namespace Kibio {
 
 
+uint64_t Layer::_maskVersionCount = 0;
+
+
+Layer::ColorGrade::ColorGrade():
+    brightness(0),
+    contrast(1),
+    gamma(1),
+    inputBlack(0),
+    inputWhite(1),
+    outputBlack(0),
+    outputWhite(1)
+{
+}
+
+
+bool Layer::ColorGrade::isIdentity() const
+{
+    return brightness == 0 &&
+           contrast == 1 &&
+           gamma == 1 &&
+           inputBlack == 0 &&
+           inputWhite == 1 &&
+           outputBlack == 0 &&
+           outputWhite == 1;
+}
+
+
 Layer::Layer(Project& parent):
     _parent(parent),
+    _temporalMask(0),
+    _maskDecay(0),
+    _maskGrowth(0),
+    _isMaskBlank(true),
+    _isMaskBlack(false),
+    _isVisible(true),
+    _isOpaqueDrawn(false),
+    _maskVersion(0),
     _maskDirty(true),
+    _isDirty(true),
+    _surfaceDirty(true),
+    _surfaceScale(1),
     _id(Poco::UUIDGenerator().createRandom()),
     _color(ofColor(255, 255, 255)),
-    _highlightColor(255, 255, 0)
+    _highlightColor(255, 255, 0),
+    _compositeMode(COMPOSITE_DIRECT),
+    _opacity(1),
+    _blendMode(OF_BLENDMODE_ALPHA),
+    _colorMatrix(VideoSource::COLOR_MATRIX_AUTO),
+    _timeOffset(0),
+    _isCacheEnabled(false),
+    _isMatrixValid(false),
+    _isBrushing(false)
 {
-    _maskShader.load("shaders/GL3/mask");
-    _frameCombineShader.load("shaders/GL3/frame_combine");
+    _maskShader = ResourceRegistry::getDefault().getShader("shaders/GL3/mask");
 
-    _surface.allocate(1, 1, GL_RGBA, 8);
-    _maskSurface.allocate(1, 1, GL_RGBA, 8);
+    // Samplers of different types must never share a texture unit.
+    _maskShader->begin();
+    _maskShader->setUniform1i("uvTex", 2);
+    _maskShader->setUniform1i("vTex", 3);
+    _maskShader->setUniform1i("compressedTex", 4);
+    _maskShader->setUniform1i("lutTex", 5);
+    _maskShader->end();
+    _frameCombineShader = ResourceRegistry::getDefault().getShader("shaders/GL3/frame_combine");
 
-    ofLoadImage(_brushTex, "brushes/brush.png");
+    _maskSurface.allocate(1, 1, GL_R8, 0);
+
+    _brushTex = ResourceRegistry::getDefault().getTexture("brushes/brush.png");
 }
 
 
@@ -57,22 +110,22 @@ void Layer::update()
 {
     if (_video)
     {
-        _video->update();
+        // The shared source was already updated by the project.
+        if (_video->isFrameNew())
+        {
+            _surfaceDirty = true;
+        }
 
         if (_video->isLoaded() &&
-            (_surface.getWidth() != _video->getWidth() ||
-            _surface.getHeight() != _video->getHeight()))
+            (_maskSurface.getWidth() != _video->getWidth() ||
+            _maskSurface.getHeight() != _video->getHeight()))
         {
-            _video->play();
-            _video->setLoopState(OF_LOOP_NORMAL);
-            _video->getTexture();
-
             float sW = _video->getWidth();
             float sH = _video->getHeight();
 
-            ofLogNotice("Layer::update") << "Allocating surface: " << sW << " / " << sH;
-            _surface.allocate(sW, sH, GL_RGBA, 8);
-            _maskSurface.allocate(sW, sH, GL_RGBA, 8);
+            ofLogNotice("Layer::update") << "Allocating mask surface: " << sW << " / " << sH;
+            // The mask only needs a single channel and no multisampling.
+            _maskSurface.allocate(sW, sH, GL_R8, 0);
             _maskDirty = true;
             ofLogNotice("Layer::update") << "Initializing warper.";
 
@@ -124,6 +177,36 @@ void Layer::update()
             _warper.enableMouseControls();
             //_warper.enableKeyboardShortcuts();
         }
+
+        if (needsSurface())
+        {
+            // Size the surface to the screen footprint, in coarse steps so
+            // small warp changes keep the surface.
+            float surfaceScale = std::ceil(getFootprintScale() * SURFACE_SCALE_STEPS) / SURFACE_SCALE_STEPS;
+            surfaceScale = std::max(surfaceScale, 1.0f / SURFACE_SCALE_STEPS);
+
+            int width = std::ceil(_video->getWidth() * surfaceScale);
+            int height = std::ceil(_video->getHeight() * surfaceScale);
+
+            if (surfaceScale != _surfaceScale)
+            {
+                _surfaceScale = surfaceScale;
+                _surfaceDirty = true;
+            }
+
+            if (_video->isLoaded() && !RenderTargetPool::fits(_surface, width, height))
+            {
+                // Return the old surface to the pool before acquiring.
+                _surface.reset();
+                _surface = RenderTargetPool::getDefault().acquire(width, height);
+                _surfaceDirty = true;
+            }
+        }
+        else if (_surface)
+        {
+            ofLogNotice("Layer::update") << "Releasing surface.";
+            _surface.reset();
+        }
     }
 
     if (_maskDirty)
@@ -136,16 +219,65 @@ void Layer::update()
         if (_mask && _mask->isAllocated())
         {
             _mask->draw(0, 0, _maskSurface.getWidth(), _maskSurface.getHeight());
+            _isMaskBlank = false;
+            _isMaskBlack = isMaskTextureBlack();
         }
         else
         {
             ofDrawRectangle(0, 0, _maskSurface.getWidth(), _maskSurface.getHeight());
+            _isMaskBlank = true;
+            _isMaskBlack = false;
         }
 
         ofPopStyle();
         _maskSurface.end();
+        touchMask();
+        updateMaskCoverage();
+
+        // Start the temporal mask over from the painted mask.
+        if (_temporalMasks[_temporalMask].isAllocated())
+        {
+            _temporalMasks[_temporalMask].begin();
+            ofClear(0, 0, 0, 0);
+            _maskSurface.draw(0, 0);
+            _temporalMasks[_temporalMask].end();
+        }
 
         _maskDirty = false;
+        _surfaceDirty = true;
+    }
+
+    if (isMaskTemporal())
+    {
+        updateTemporalMask();
+    }
+    else if (_temporalMasks[0].isAllocated())
+    {
+        ofLogNotice("Layer::update") << "Releasing temporal mask.";
+        _temporalMasks[0].clear();
+        _temporalMasks[1].clear();
+        touchMask();
+        updateMaskCoverage();
+        _surfaceDirty = true;
+    }
+
+    if (_video && _video->isLoaded() &&
+        _warpMesh.update(_video->getWidth(), _video->getHeight()))
+    {
+        _isDirty = true;
+    }
+
+    if (!std::equal(_warper.srcPoints, _warper.srcPoints + 4, _lastSourcePoints) ||
+        !std::equal(_warper.dstPoints, _warper.dstPoints + 4, _lastTargetPoints))
+    {
+        std::copy(_warper.srcPoints, _warper.srcPoints + 4, _lastSourcePoints);
+        std::copy(_warper.dstPoints, _warper.dstPoints + 4, _lastTargetPoints);
+        _isDirty = true;
+    }
+
+    if (_surfaceDirty)
+    {
+        _isDirty = true;
     }
 
     if (_parent._parent.getMode() == AbstractApp::EDIT)
@@ -163,70 +295,169 @@ void Layer::draw()
 {
     ofPoint mouse(ofGetMouseX(), ofGetMouseY());
 
-    if (ofGetMousePressed())
+    if (ofGetMousePressed() && _parent.isMaskBrushEnabled())
     {
-        ofPoint layerMouse = screenToLayer(mouse);
+        // Stamp along the path since the last frame so fast strokes are
+        // continuous, and map all stamps to layer space at once.
+        _brushStamps.clear();
 
-        if (_parent.isMaskBrushEnabled())
+        if (_isBrushing)
         {
-            _maskPath.clear();
-            _maskSurface.begin();
-            ofPushStyle();
+            std::size_t steps = std::max(1, int(std::ceil(mouse.distance(_lastBrushPoint) / BRUSH_SPACING)));
 
-            if (ofGetKeyPressed(OF_KEY_SHIFT))
-            {
-                ofSetColor(255);
-            }
-            else
+            for (std::size_t i = 1; i <= steps; ++i)
             {
-                ofSetColor(0);
+                _brushStamps.push_back(_lastBrushPoint.getInterpolated(mouse, float(i) / steps));
             }
+        }
+        else
+        {
+            _brushStamps.push_back(mouse);
+        }
 
-            _brushTex.draw(layerMouse.x - 25, layerMouse.y - 25, 50, 50);
+        screenToLayer(&_brushStamps[0], &_brushStamps[0], _brushStamps.size());
 
-            ofPopStyle();
+        _lastBrushPoint = mouse;
+        _isBrushing = true;
+
+        // Temporal masks take strokes in the accumulated mask, which fades,
+        // and keep the painted mask.
+        ofFbo& target = isMaskTemporal() ? _temporalMasks[_temporalMask] : _maskSurface;
+
+        if (!isMaskTemporal())
+        {
+            _maskPath.clear();
+            _isMaskBlank = false;
+            _isMaskBlack = false;
 
-            _maskSurface.end();
+            // The coverage is analysed again once the stroke ends.
+            _maskCoverage.clear();
         }
-    }
 
-    _surface.begin();
-    ofClear(0, 0, 0, 0);
+        touchMask();
 
-    ofPushStyle();
+        _surfaceDirty = true;
+        _isDirty = true;
+        target.begin();
+        ofPushStyle();
+
+        if (ofGetKeyPressed(OF_KEY_SHIFT))
+        {
+            ofSetColor(255);
+        }
+        else
+        {
+            ofSetColor(0);
+        }
+
+        if (_brushTex)
+        {
+            for (std::size_t i = 0; i < _brushStamps.size(); ++i)
+            {
+                _brushTex->draw(_brushStamps[i].x - BRUSH_SIZE / 2,
+                                _brushStamps[i].y - BRUSH_SIZE / 2,
+                                BRUSH_SIZE,
+                                BRUSH_SIZE);
+            }
+        }
 
-    _maskShader.begin();
-    _maskShader.setUniformTexture("maskTex", _maskSurface.getTexture(), 1);
+        ofPopStyle();
 
-    if (_video && _video->isLoaded())
+        target.end();
+    }
+    else
     {
-        _video->draw(0, 0);
+        if (_isBrushing)
+        {
+            updateMaskCoverage();
+        }
+
+        _isBrushing = false;
     }
 
-    _maskShader.end();
+    if (needsSurface() && _surface && _video)
+    {
+        // Reuse the last masked frame until the frame or mask changes.
+        if (_surfaceDirty)
+        {
+            _surface->begin();
+            ofClear(0, 0, 0, 0);
 
-    ofPopStyle();
+            ofPushStyle();
 
-    _surface.end();
+            _maskShader->begin();
+            _maskShader->setUniformTexture("maskTex", getMaskTexture(), 1);
+            _maskShader->setUniform1f("opacity", 1);
+            beginColorGrade();
 
-    // Warp.
-    ofPushMatrix();
-    ofMultMatrix(_warper.getMatrix());
-    _surface.draw(0, 0);
-    ofPopMatrix();
+            if (_video && _video->isLoaded())
+            {
+                ofPushMatrix();
+                ofScale(_surfaceScale, _surfaceScale);
+                _video->setShaderUniforms(*_maskShader);
+                _video->draw(0, 0);
+                ofPopMatrix();
+            }
+
+            endColorGrade();
+            _maskShader->end();
+
+            ofPopStyle();
+
+            _surface->end();
+        }
+
+        // Warp.
+        ofPushStyle();
+        ofEnableBlendMode(_blendMode);
+        ofSetColor(255, 255 * _opacity);
+        ofPushMatrix();
+        ofMultMatrix(getMatrix());
+
+        // Pooled surfaces are usually larger than the video, the mesh only
+        // covers the video in pixels, scaled down to the surface.
+        _surface->getTexture().setTextureMatrix(ofMatrix4x4::newScaleMatrix(_surfaceScale, _surfaceScale, 1));
+        _surface->getTexture().bind();
+        drawGeometry();
+        _surface->getTexture().unbind();
+        _surface->getTexture().disableTextureMatrix();
+        ofPopMatrix();
+        ofPopStyle();
+    }
+    else if (_video && _video->isLoaded())
+    {
+        // Mask and warp in a single pass.
+        ofPushStyle();
+        ofEnableBlendMode(_blendMode);
+        ofPushMatrix();
+        ofMultMatrix(getMatrix());
+
+        _maskShader->begin();
+        _maskShader->setUniformTexture("maskTex", getMaskTexture(), 1);
+        _maskShader->setUniform1f("opacity", _opacity);
+        beginColorGrade();
+        _video->setShaderUniforms(*_maskShader);
+        drawGeometry();
+        endColorGrade();
+        _maskShader->end();
+
+        ofPopMatrix();
+        ofPopStyle();
+    }
+
+    _surfaceDirty = false;
+    _isDirty = false;
+    _isOpaqueDrawn = false;
 
     if (_warper.isShowing())
     {
         ofPushStyle();
 
-        std::shared_ptr<Layer> layer = _parent.getLayerAtPoint(mouse);
-        
-        // TODO: Only when layer is on top
-        if (layer &&
+        // The hovered layer is resolved once per frame by the project.
+        if (_parent.getHoveredLayer().get() == this &&
             !_parent._dragging &&
             _parent._transform != Project::NONE &&
-            layer->getId() == getId() &&
-            !_parent.isCornerHovered(mouse))
+            !_parent.isCornerHovered())
         {
             ofSetColor(_highlightColor);
         }
@@ -244,6 +475,28 @@ void Layer::draw()
             ofDrawCircle(corners[i], 6);
         }
         
+        if (_warpMesh.getMode() == WarpMesh::MODE_BEZIER && _video)
+        {
+            ofPoint lattice[WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE];
+
+            for (std::size_t row = 0; row < WarpMesh::LATTICE_SIZE; ++row)
+            {
+                for (std::size_t column = 0; column < WarpMesh::LATTICE_SIZE; ++column)
+                {
+                    const ofPoint& point = _warpMesh.getControlPoint(column, row);
+                    lattice[row * WarpMesh::LATTICE_SIZE + column] = ofPoint(point.x * _video->getWidth(),
+                                                                             point.y * _video->getHeight());
+                }
+            }
+
+            layerToScreen(lattice, lattice, WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE);
+
+            for (std::size_t i = 0; i < WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE; ++i)
+            {
+                ofDrawCircle(lattice[i], 3);
+            }
+        }
+
         const ofPoint* hoveredCorner = getHoveredCorner(mouse);
 
         if (hoveredCorner)
@@ -258,6 +511,45 @@ void Layer::draw()
 }
     
     
+void Layer::setTimeOffset(double offset)
+{
+    if (offset != _timeOffset)
+    {
+        _timeOffset = offset;
+
+        // Layers only share a source with layers at the same offset.
+        if (_video)
+        {
+            loadVideo(_videoPath);
+        }
+    }
+}
+
+
+double Layer::getTimeOffset() const
+{
+    return _timeOffset;
+}
+
+
+void Layer::setCacheEnabled(bool cacheEnabled)
+{
+    _isCacheEnabled = cacheEnabled;
+}
+
+
+bool Layer::isCacheEnabled() const
+{
+    return _isCacheEnabled;
+}
+
+
+bool Layer::isDirty() const
+{
+    return _isDirty;
+}
+
+
 void Layer::drawTranslatePreview(const ofPoint& mouse, const ofPoint& dragStart)
 {
     ofPoint delta = dragStart - mouse;
@@ -349,10 +641,26 @@ void Layer::drawScalePreview(const ofPoint& mouse, const ofPoint& dragStart)
 
 bool Layer::hitTest(const ofPoint& point) const
 {
-    const ofPoint* p = getHoveredCorner(point);
+    if (getHoveredCorner(point))
+    {
+        return false;
+    }
+
+    // A crossing test on the quad, without allocating a polyline.
+    const ofPoint* points = _warper.dstPoints;
+
+    bool isInside = false;
+
+    for (std::size_t i = 0, j = 3; i < 4; j = i++)
+    {
+        if ((points[i].y > point.y) != (points[j].y > point.y) &&
+            point.x < (points[j].x - points[i].x) * (point.y - points[i].y) / (points[j].y - points[i].y) + points[i].x)
+        {
+            isInside = !isInside;
+        }
+    }
 
-    return (!p && ofPolyline(std::vector<ofPoint>(_warper.dstPoints,
-                                                  _warper.dstPoints + 4)).inside(point));
+    return isInside;
 }
 
     
@@ -377,142 +685,396 @@ const ofPoint* Layer::getHoveredCorner(const ofPoint& mouse) const
     return p;
 }
     
-ofPoint Layer::getCentroid() const
+const ofPoint* Layer::getTargetPoints() const
 {
-    const ofPoint* dstPoints = _warper.dstPoints;
+    return _warper.dstPoints;
+}
 
-    float maxX = max(max(dstPoints[0].x, dstPoints[1].x),
-                     max(dstPoints[2].x, dstPoints[3].x));
 
-    float minX = min(min(dstPoints[0].x, dstPoints[1].x),
-                     min(dstPoints[2].x, dstPoints[3].x));
+ofRectangle Layer::getBounds() const
+{
+    ofRectangle bounds(_warper.dstPoints[0], _warper.dstPoints[0]);
 
-    float maxY = max(max(dstPoints[0].y, dstPoints[1].y),
-                     max(dstPoints[2].y, dstPoints[3].y));
+    for (std::size_t i = 1; i < 4; ++i)
+    {
+        bounds.growToInclude(_warper.dstPoints[i]);
+    }
 
-    float minY = min(min(dstPoints[0].y, dstPoints[1].y),
-                     min(dstPoints[2].y, dstPoints[3].y));
-    
-    return ofPoint(minX + ((maxX - minX) * 0.5), minY + ((maxY - minY) * 0.5));
-}
+    if (_warpMesh.getMode() == WarpMesh::MODE_BEZIER && _video)
+    {
+        ofPoint lattice[WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE];
 
+        for (std::size_t row = 0; row < WarpMesh::LATTICE_SIZE; ++row)
+        {
+            for (std::size_t column = 0; column < WarpMesh::LATTICE_SIZE; ++column)
+            {
+                const ofPoint& point = _warpMesh.getControlPoint(column, row);
+                lattice[row * WarpMesh::LATTICE_SIZE + column] = ofPoint(point.x * _video->getWidth(),
+                                                                         point.y * _video->getHeight());
+            }
+        }
 
-ofPoint Layer::screenToLayer(const ofPoint& point)
-{
-    return _warper.getMatrixInverse().preMult(point);
-//    return _warper.getMatrix().postMult(point);
-}
+        layerToScreen(lattice, lattice, WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE);
 
+        for (std::size_t i = 0; i < WarpMesh::LATTICE_SIZE * WarpMesh::LATTICE_SIZE; ++i)
+        {
+            bounds.growToInclude(lattice[i]);
+        }
+    }
 
-ofPoint Layer::layerToScreen(const ofPoint& point)
-{
-    return _warper.getMatrix().preMult(point);
+    return bounds;
 }
 
 
-bool Layer::loadVideo(const std::string& path)
+float Layer::getFootprintScale() const
 {
-    Poco::Path fullyQualifiedPath(_parent.getPath(), path);
-
-    _video = std::shared_ptr<ofVideoPlayer>(new ofVideoPlayer());
-
-    if (_video->load(fullyQualifiedPath.toString()))
+    if (!_video || _video->getWidth() <= 0 || _video->getHeight() <= 0)
     {
-        _videoPath = path;
-        _maskDirty = true;
-        return true;
+        return 1;
     }
-    else
+
+    // The destination points are top left, top right, bottom right and
+    // bottom left.
+    const ofPoint* points = _warper.dstPoints;
+
+    float width = std::max(points[0].distance(points[1]), points[3].distance(points[2]));
+    float height = std::max(points[0].distance(points[3]), points[1].distance(points[2]));
+
+    if (_warpMesh.getMode() == WarpMesh::MODE_BEZIER)
     {
-        _videoPath = "";
-        _video.reset();
-        _maskDirty = true;
-        return false;
+        // Curved edges can be longer than the quad, the lattice bounds are not.
+        ofRectangle bounds = getBounds();
+        width = std::max(width, bounds.getWidth());
+        height = std::max(height, bounds.getHeight());
     }
+
+    return std::min(1.0f, std::max(width / _video->getWidth(),
+                                   height / _video->getHeight()));
 }
 
 
-bool Layer::loadMask(const std::string& path)
+int Layer::getDownscaleLevel() const
 {
-    Poco::Path fullyQualifiedPath(_parent.getPath(), path);
+    float scale = getFootprintScale();
+    int level = 0;
 
-    if (_video)
-    {
-        _maskPath = path;
-        _mask = std::shared_ptr<ofTexture>(new ofTexture());
-        _maskDirty = true;
-        ofLoadImage(*_mask, fullyQualifiedPath.toString());
-        return true;
-    }
-    else
+    // Halve while the next level still has a texel per screen pixel.
+    while (level < VideoSource::MAX_DOWNSCALE && std::ldexp(1.0f, -(level + 1)) >= scale)
     {
-        _maskDirty = true;
-        _maskPath = "";
-        ofLogError("Layer::loadMask") << "Mask cannot be loaded before the video.";
-        return false;
+        ++level;
     }
+
+    return level;
 }
 
 
-bool Layer::saveMask()
+bool Layer::isHidden() const
 {
-    if (!_mask)
-    {
-        ofLogWarning("Layer::saveMask") << "There is no mask to save.";
-        return false;
-    }
-    if (!_maskPath.empty())
-    {
-        ofLogWarning("Layer::saveMask") << "The mask has not been modified.";
-        return false;
-    }
-    else
-    {
-        _maskPath = "assets/masks/" + ofGetTimestampString() + "-lastmask.png";
-        ofPixels pixels;
-        _maskSurface.getTexture().readToPixels(pixels);
-        Poco::Path fullyQualifiedPath(_parent.getPath(), _maskPath);
-        ofSaveImage(pixels, fullyQualifiedPath.toString());
-        return true;
-    }
+    return _opacity <= 0 || (_isMaskBlack && !isMaskTemporal());
 }
 
 
-void Layer::clearMask()
+bool Layer::isOpaque() const
 {
-    _mask.reset();
-    _maskPath.clear();
-    _maskDirty = true;
+    return _video &&
+           _video->isLoaded() &&
+           _opacity >= 1 &&
+           (_blendMode == OF_BLENDMODE_ALPHA || _blendMode == OF_BLENDMODE_DISABLED) &&
+           !hasMask() &&
+           _warpMesh.getMode() == WarpMesh::MODE_PERSPECTIVE;
 }
 
 
-void Layer::translate(const ofPoint& delta)
+bool Layer::covers(const ofRectangle& bounds) const
 {
+    const ofPoint* quad = _warper.dstPoints;
+
+    ofPoint corners[4] = {
+        bounds.getTopLeft(),
+        bounds.getTopRight(),
+        bounds.getBottomRight(),
+        bounds.getBottomLeft()
+    };
+
+    // A convex quad turns the same way at every corner, and contains a
+    // rectangle if it contains its corners.
+    float sign = 0;
+
     for (std::size_t i = 0; i < 4; ++i)
     {
-        _warper.getTargetPoints()[i] += delta;
-    }
-}
+        const ofPoint& a = quad[i];
+        const ofPoint& b = quad[(i + 1) % 4];
+        const ofPoint& c = quad[(i + 2) % 4];
 
+        float turn = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
 
-void Layer::rotate(int degrees)
-{
-    // because of a current bug in OF Master (pre v0.9.0)
-    // ofPoints here must be ofVec2fs
+        if (turn == 0 || (sign != 0 && (turn > 0) != (sign > 0)))
+        {
+            return false;
+        }
+
+        sign = turn;
+    }
 
-    ofVec2f centroid = getCentroid();
-    
     for (std::size_t i = 0; i < 4; ++i)
     {
-        ofVec2f point = _warper.getTargetPoints()[i];
-        point.rotate(degrees, centroid);
-        _warper.getTargetPoints()[i] = point;
-    }
-}
-    
+        const ofPoint& a = quad[i];
+        const ofPoint& b = quad[(i + 1) % 4];
 
-void Layer::scale(float mult)
-{
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            float side = (b.x - a.x) * (corners[j].y - a.y) - (b.y - a.y) * (corners[j].x - a.x);
+
+            if (side != 0 && (side > 0) != (sign > 0))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool Layer::isVisible() const
+{
+    return _isVisible;
+}
+
+
+bool Layer::isBatchable() const
+{
+    return _video &&
+           _video->isLoaded() &&
+           _compositeMode == COMPOSITE_DIRECT &&
+           _warpMesh.getMode() == WarpMesh::MODE_PERSPECTIVE &&
+           _colorGrade.isIdentity() &&
+           !_lut &&
+           _parent._parent.getMode() != AbstractApp::EDIT;
+}
+
+
+ofPoint Layer::getCentroid() const
+{
+    const ofPoint* dstPoints = _warper.dstPoints;
+
+    float maxX = max(max(dstPoints[0].x, dstPoints[1].x),
+                     max(dstPoints[2].x, dstPoints[3].x));
+
+    float minX = min(min(dstPoints[0].x, dstPoints[1].x),
+                     min(dstPoints[2].x, dstPoints[3].x));
+
+    float maxY = max(max(dstPoints[0].y, dstPoints[1].y),
+                     max(dstPoints[2].y, dstPoints[3].y));
+
+    float minY = min(min(dstPoints[0].y, dstPoints[1].y),
+                     min(dstPoints[2].y, dstPoints[3].y));
+    
+    return ofPoint(minX + ((maxX - minX) * 0.5), minY + ((maxY - minY) * 0.5));
+}
+
+
+ofPoint Layer::screenToLayer(const ofPoint& point) const
+{
+    return getMatrixInverse().preMult(point);
+}
+
+
+ofPoint Layer::layerToScreen(const ofPoint& point) const
+{
+    return getMatrix().preMult(point);
+}
+
+
+void Layer::screenToLayer(const ofPoint* points, ofPoint* result, std::size_t count) const
+{
+    const ofMatrix4x4& matrix = getMatrixInverse();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        result[i] = matrix.preMult(points[i]);
+    }
+}
+
+
+void Layer::layerToScreen(const ofPoint* points, ofPoint* result, std::size_t count) const
+{
+    const ofMatrix4x4& matrix = getMatrix();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        result[i] = matrix.preMult(points[i]);
+    }
+}
+
+
+const ofMatrix4x4& Layer::getMatrix() const
+{
+    updateMatrices();
+    return _matrix;
+}
+
+
+const ofMatrix4x4& Layer::getMatrixInverse() const
+{
+    updateMatrices();
+    return _matrixInverse;
+}
+
+
+void Layer::updateMatrices() const
+{
+    // Comparing the points also catches corner drags made by the warper.
+    if (!_isMatrixValid ||
+        !std::equal(_warper.srcPoints, _warper.srcPoints + 4, _matrixSourcePoints) ||
+        !std::equal(_warper.dstPoints, _warper.dstPoints + 4, _matrixTargetPoints))
+    {
+        std::copy(_warper.srcPoints, _warper.srcPoints + 4, _matrixSourcePoints);
+        std::copy(_warper.dstPoints, _warper.dstPoints + 4, _matrixTargetPoints);
+        _matrix = _warper.getMatrix();
+        _matrixInverse = _matrix.getInverse();
+        _isMatrixValid = true;
+    }
+}
+
+
+bool Layer::loadVideo(const std::string& path)
+{
+    Poco::Path fullyQualifiedPath(_parent.getPath(), path);
+
+    _video = _parent.getVideoSource(fullyQualifiedPath.toString(),
+                                    _timeOffset,
+                                    _isCacheEnabled);
+
+    if (_video)
+    {
+        _video->setColorMatrix(_colorMatrix);
+        _videoPath = path;
+        _maskDirty = true;
+        return true;
+    }
+    else
+    {
+        _videoPath = "";
+        _video.reset();
+        _maskDirty = true;
+        return false;
+    }
+}
+
+
+bool Layer::loadMask(const std::string& path)
+{
+    Poco::Path fullyQualifiedPath(_parent.getPath(), path);
+
+    if (_video)
+    {
+        _maskPath = path;
+        _mask = ResourceRegistry::getDefault().getTexture(fullyQualifiedPath.toString());
+        _maskDirty = true;
+        return true;
+    }
+    else
+    {
+        _maskDirty = true;
+        _maskPath = "";
+        ofLogError("Layer::loadMask") << "Mask cannot be loaded before the video.";
+        return false;
+    }
+}
+
+
+bool Layer::saveMask()
+{
+    if (!_mask)
+    {
+        ofLogWarning("Layer::saveMask") << "There is no mask to save.";
+        return false;
+    }
+    if (!_maskPath.empty())
+    {
+        ofLogWarning("Layer::saveMask") << "The mask has not been modified.";
+        return false;
+    }
+    else
+    {
+        _maskPath = "assets/masks/" + ofGetTimestampString() + "-lastmask.png";
+        ofPixels pixels;
+        _maskSurface.getTexture().readToPixels(pixels);
+        Poco::Path fullyQualifiedPath(_parent.getPath(), _maskPath);
+        ofSaveImage(pixels, fullyQualifiedPath.toString());
+        return true;
+    }
+}
+
+
+void Layer::clearMask()
+{
+    _mask.reset();
+    _maskPath.clear();
+    _maskDirty = true;
+}
+
+
+void Layer::setMaskDecay(float decay)
+{
+    _maskDecay = ofClamp(decay, 0, 1);
+    _isDirty = true;
+}
+
+
+float Layer::getMaskDecay() const
+{
+    return _maskDecay;
+}
+
+
+void Layer::setMaskGrowth(float growth)
+{
+    _maskGrowth = std::max(0.0f, growth);
+    _isDirty = true;
+}
+
+
+float Layer::getMaskGrowth() const
+{
+    return _maskGrowth;
+}
+
+
+bool Layer::isMaskTemporal() const
+{
+    return _maskDecay > 0 || _maskGrowth > 0;
+}
+
+
+void Layer::translate(const ofPoint& delta)
+{
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        _warper.getTargetPoints()[i] += delta;
+    }
+}
+
+
+void Layer::rotate(int degrees)
+{
+    // because of a current bug in OF Master (pre v0.9.0)
+    // ofPoints here must be ofVec2fs
+
+    ofVec2f centroid = getCentroid();
+    
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        ofVec2f point = _warper.getTargetPoints()[i];
+        point.rotate(degrees, centroid);
+        _warper.getTargetPoints()[i] = point;
+    }
+}
+    
+
+void Layer::scale(float mult)
+{
     ofPoint centroid = getCentroid();
     ofPoint* corners = _warper.getTargetPoints();
     
@@ -537,21 +1099,77 @@ Json::Value Layer::toJSON(const Layer& object)
 
     Json::Value json;
 
+    json["id"] = object._id.toString();
     json["video"]["path"] = object._videoPath;
+
+    if (!object._instanceOf.isNull())
+    {
+        json["video"]["instanceOf"] = object._instanceOf.toString();
+    }
+
+    json["video"]["colorspace"] = toString(object._colorMatrix);
+    json["video"]["offset"] = object._timeOffset;
+    json["video"]["cache"] = object._isCacheEnabled;
     json["mask"]["path"] = object._maskPath;
+    json["mask"]["decay"] = object._maskDecay;
+    json["mask"]["growth"] = object._maskGrowth;
     json["quad"]["source"] = toJSON(sourcePoints);
     json["quad"]["destination"] = toJSON(destinationPoints);
 
+    switch (object._compositeMode)
+    {
+        case COMPOSITE_DIRECT:
+            json["composite"]["mode"] = "direct";
+            break;
+        case COMPOSITE_SURFACE:
+            json["composite"]["mode"] = "surface";
+            break;
+    }
+
+    json["warp"] = WarpMesh::toJSON(object._warpMesh);
+    json["composite"]["opacity"] = object._opacity;
+    json["composite"]["blend"] = toString(object._blendMode);
+
+    json["color"]["brightness"] = object._colorGrade.brightness;
+    json["color"]["contrast"] = object._colorGrade.contrast;
+    json["color"]["gamma"] = object._colorGrade.gamma;
+    json["color"]["levels"]["inputBlack"] = object._colorGrade.inputBlack;
+    json["color"]["levels"]["inputWhite"] = object._colorGrade.inputWhite;
+    json["color"]["levels"]["outputBlack"] = object._colorGrade.outputBlack;
+    json["color"]["levels"]["outputWhite"] = object._colorGrade.outputWhite;
+    json["color"]["lut"] = object._lutPath;
+
     return json;
 }
 
 
 bool Layer::fromJSON(const Json::Value& json, Layer& object)
 {
+    try
+    {
+        if (json.isMember("id"))
+        {
+            object._id = Poco::UUID(json["id"].asString());
+        }
+
+        if (json.isMember("video") && json["video"].isMember("instanceOf"))
+        {
+            object._instanceOf = Poco::UUID(json["video"]["instanceOf"].asString());
+        }
+    }
+    catch (const Poco::Exception& exc)
+    {
+        ofLogWarning("Layer::fromJSON") << "Invalid layer id: " << exc.displayText();
+    }
+
     if (json.isMember("video"))
     {
         const Json::Value& video = json["video"];
 
+        object.setColorMatrix(colorMatrixFromString(video.get("colorspace", "auto").asString()));
+        object.setTimeOffset(video.get("offset", 0).asDouble());
+        object.setCacheEnabled(video.get("cache", false).asBool());
+
         if (video.isMember("path"))
         {
             std::string path = video["path"].asString();
@@ -582,6 +1200,9 @@ bool Layer::fromJSON(const Json::Value& json, Layer& object)
                 return false;
             }
         }
+
+        object.setMaskDecay(mask.get("decay", 0).asFloat());
+        object.setMaskGrowth(mask.get("growth", 0).asFloat());
     }
     else
     {
@@ -644,9 +1265,404 @@ bool Layer::fromJSON(const Json::Value& json, Layer& object)
         ofLogWarning("Layer::fromJSON") << "No quad specified.";
     }
 
+    if (json.isMember("composite"))
+    {
+        const Json::Value& composite = json["composite"];
+
+        if ("surface" == composite.get("mode", "direct").asString())
+        {
+            object.setCompositeMode(COMPOSITE_SURFACE);
+        }
+        else
+        {
+            object.setCompositeMode(COMPOSITE_DIRECT);
+        }
+
+        object.setOpacity(composite.get("opacity", 1).asFloat());
+        object.setBlendMode(blendModeFromString(composite.get("blend", "alpha").asString()));
+    }
+
+    if (json.isMember("warp") && !WarpMesh::fromJSON(json["warp"], object._warpMesh))
+    {
+        ofLogWarning("Layer::fromJSON") << "Invalid warp, using a flat lattice.";
+    }
+
+    if (json.isMember("color"))
+    {
+        const Json::Value& color = json["color"];
+        const Json::Value& levels = color["levels"];
+
+        ColorGrade colorGrade;
+        colorGrade.brightness = color.get("brightness", colorGrade.brightness).asFloat();
+        colorGrade.contrast = color.get("contrast", colorGrade.contrast).asFloat();
+        colorGrade.gamma = color.get("gamma", colorGrade.gamma).asFloat();
+        colorGrade.inputBlack = levels.get("inputBlack", colorGrade.inputBlack).asFloat();
+        colorGrade.inputWhite = levels.get("inputWhite", colorGrade.inputWhite).asFloat();
+        colorGrade.outputBlack = levels.get("outputBlack", colorGrade.outputBlack).asFloat();
+        colorGrade.outputWhite = levels.get("outputWhite", colorGrade.outputWhite).asFloat();
+        object.setColorGrade(colorGrade);
+
+        std::string path = color.get("lut", "").asString();
+
+        if (!path.empty() && !object.loadLut(path))
+        {
+            ofLogError("Layer::fromJSON") << "could not load lut at " << path;
+        }
+    }
+
     return true;
 }
     
+void Layer::setCompositeMode(CompositeMode mode)
+{
+    _compositeMode = mode;
+    _surfaceDirty = true;
+    _isDirty = true;
+}
+
+
+Layer::CompositeMode Layer::getCompositeMode() const
+{
+    return _compositeMode;
+}
+
+
+void Layer::setOpacity(float opacity)
+{
+    _opacity = ofClamp(opacity, 0, 1);
+    _isDirty = true;
+}
+
+
+float Layer::getOpacity() const
+{
+    return _opacity;
+}
+
+
+void Layer::setBlendMode(ofBlendMode blendMode)
+{
+    _blendMode = blendMode;
+    _isDirty = true;
+}
+
+
+ofBlendMode Layer::getBlendMode() const
+{
+    return _blendMode;
+}
+
+
+void Layer::setColorMatrix(VideoSource::ColorMatrix colorMatrix)
+{
+    _colorMatrix = colorMatrix;
+    _surfaceDirty = true;
+    _isDirty = true;
+
+    if (_video)
+    {
+        _video->setColorMatrix(colorMatrix);
+    }
+}
+
+
+VideoSource::ColorMatrix Layer::getColorMatrix() const
+{
+    return _colorMatrix;
+}
+
+
+void Layer::setColorGrade(const ColorGrade& colorGrade)
+{
+    _colorGrade = colorGrade;
+    _colorGrade.gamma = std::max(0.01f, _colorGrade.gamma);
+    _colorGrade.contrast = std::max(0.0f, _colorGrade.contrast);
+    _surfaceDirty = true;
+    _isDirty = true;
+}
+
+
+const Layer::ColorGrade& Layer::getColorGrade() const
+{
+    return _colorGrade;
+}
+
+
+bool Layer::loadLut(const std::string& path)
+{
+    Poco::Path fullyQualifiedPath(_parent.getPath(), path);
+
+    std::shared_ptr<Lut3D> lut = ResourceRegistry::getDefault().getLut(fullyQualifiedPath.toString());
+
+    if (!lut)
+    {
+        return false;
+    }
+
+    _lut = lut;
+    _lutPath = path;
+    _surfaceDirty = true;
+    _isDirty = true;
+    return true;
+}
+
+
+void Layer::clearLut()
+{
+    _lut.reset();
+    _lutPath.clear();
+    _surfaceDirty = true;
+    _isDirty = true;
+}
+
+
+const std::string& Layer::getLutPath() const
+{
+    return _lutPath;
+}
+
+
+TextureUploader::Stats Layer::getUploadStats() const
+{
+    if (_video)
+    {
+        return _video->getUploadStats();
+    }
+    else
+    {
+        return TextureUploader::Stats();
+    }
+}
+
+
+bool Layer::needsSurface() const
+{
+    return _compositeMode == COMPOSITE_SURFACE;
+}
+
+
+void Layer::beginColorGrade() const
+{
+    // Identity grades skip the colour math in the shader entirely.
+    _maskShader->setUniform1i("gradeEnabled", _colorGrade.isIdentity() ? 0 : 1);
+    _maskShader->setUniform4f("levels",
+                              _colorGrade.inputBlack,
+                              std::max(_colorGrade.inputWhite, _colorGrade.inputBlack + 0.001f),
+                              _colorGrade.outputBlack,
+                              _colorGrade.outputWhite);
+    _maskShader->setUniform1f("gamma", _colorGrade.gamma);
+    _maskShader->setUniform1f("contrast", _colorGrade.contrast);
+    _maskShader->setUniform1f("brightness", _colorGrade.brightness);
+
+    if (_lut)
+    {
+        _lut->bind(5);
+        _maskShader->setUniform1i("lutEnabled", 1);
+        _maskShader->setUniform3f("lutScale", _lut->getScale().x, _lut->getScale().y, _lut->getScale().z);
+        _maskShader->setUniform3f("lutOffset", _lut->getOffset().x, _lut->getOffset().y, _lut->getOffset().z);
+    }
+    else
+    {
+        _maskShader->setUniform1i("lutEnabled", 0);
+    }
+}
+
+
+void Layer::endColorGrade() const
+{
+    if (_lut)
+    {
+        _lut->unbind(5);
+    }
+}
+
+
+void Layer::updateTemporalMask()
+{
+    float width = _maskSurface.getWidth();
+    float height = _maskSurface.getHeight();
+
+    if (_temporalMasks[0].getWidth() != width ||
+        _temporalMasks[0].getHeight() != height)
+    {
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            _temporalMasks[i].allocate(width, height, GL_R8, 0);
+        }
+
+        _temporalMask = 0;
+        _temporalMasks[_temporalMask].begin();
+        ofClear(0, 0, 0, 0);
+        _maskSurface.draw(0, 0);
+        _temporalMasks[_temporalMask].end();
+    }
+
+    // Rates are per second so the mask fades the same at any frame rate.
+    float frameTime = ofGetLastFrameTime();
+    std::size_t next = 1 - _temporalMask;
+
+    _temporalMasks[next].begin();
+    ofPushStyle();
+    ofDisableBlendMode();
+    _frameCombineShader->begin();
+    _frameCombineShader->setUniformTexture("frameTex", _temporalMasks[_temporalMask].getTexture(), 1);
+    _frameCombineShader->setUniform1f("retention", std::pow(1.0f - _maskDecay, frameTime));
+    _frameCombineShader->setUniform1f("growth", _maskGrowth * frameTime);
+    _maskSurface.draw(0, 0);
+    _frameCombineShader->end();
+    ofPopStyle();
+    _temporalMasks[next].end();
+
+    _temporalMask = next;
+    touchMask();
+    _surfaceDirty = true;
+}
+
+
+const ofTexture& Layer::getMaskTexture() const
+{
+    return getMaskFbo().getTexture();
+}
+
+
+const ofFbo& Layer::getMaskFbo() const
+{
+    if (isMaskTemporal() && _temporalMasks[_temporalMask].isAllocated())
+    {
+        return _temporalMasks[_temporalMask];
+    }
+
+    return _maskSurface;
+}
+
+
+bool Layer::hasMask() const
+{
+    return isMaskTemporal() || !_isMaskBlank;
+}
+
+
+bool Layer::isMaskTextureBlack() const
+{
+    // Read back once per loaded mask, never per frame.
+    ofPixels pixels;
+    _mask->readToPixels(pixels);
+
+    const unsigned char* data = pixels.getData();
+    std::size_t channels = pixels.getNumChannels();
+    std::size_t size = pixels.getWidth() * pixels.getHeight() * channels;
+
+    // The first channel is drawn into the mask, scaled by alpha if present.
+    bool hasAlpha = (2 == channels || 4 == channels);
+
+    for (std::size_t i = 0; i < size; i += channels)
+    {
+        if (data[i] != 0 && (!hasAlpha || data[i + channels - 1] != 0))
+        {
+            return false;
+        }
+    }
+
+    return size > 0;
+}
+
+
+void Layer::touchMask()
+{
+    _maskVersion = ++_maskVersionCount;
+}
+
+
+void Layer::updateMaskCoverage()
+{
+    if (isMaskTemporal())
+    {
+        _maskCoverage.clear();
+        return;
+    }
+
+    ofPixels pixels;
+    _maskSurface.readToPixels(pixels);
+    _maskCoverage.update(pixels);
+}
+
+
+void Layer::drawGeometry() const
+{
+    // The tiles cover the mask, which is the size of the video, so they
+    // only replace the planar grid.
+    if (_maskCoverage.isValid() &&
+        _warpMesh.getMode() == WarpMesh::MODE_PERSPECTIVE &&
+        !isMaskTemporal())
+    {
+        _maskCoverage.drawPartial();
+
+        if (!_isOpaqueDrawn)
+        {
+            _maskCoverage.drawFull();
+        }
+    }
+    else
+    {
+        _warpMesh.draw();
+    }
+}
+
+
+bool Layer::isOpaqueDrawable() const
+{
+    return _video &&
+           _video->isLoaded() &&
+           _compositeMode == COMPOSITE_DIRECT &&
+           _warpMesh.getMode() == WarpMesh::MODE_PERSPECTIVE &&
+           _opacity >= 1 &&
+           (_blendMode == OF_BLENDMODE_ALPHA || _blendMode == OF_BLENDMODE_DISABLED) &&
+           !isMaskTemporal() &&
+           _maskCoverage.hasFullTiles();
+}
+
+
+void Layer::drawOpaqueTiles()
+{
+    ofPushStyle();
+    ofDisableBlendMode();
+    ofPushMatrix();
+    ofMultMatrix(getMatrix());
+
+    _maskShader->begin();
+    _maskShader->setUniformTexture("maskTex", getMaskTexture(), 1);
+    _maskShader->setUniform1f("opacity", 1);
+    beginColorGrade();
+    _video->setShaderUniforms(*_maskShader);
+    _maskCoverage.drawFull();
+    endColorGrade();
+    _maskShader->end();
+
+    ofPopMatrix();
+    ofPopStyle();
+
+    _isOpaqueDrawn = true;
+}
+
+
+void Layer::setInstanceOf(const Layer& layer)
+{
+    _instanceOf = layer._id;
+    _timeOffset = layer._timeOffset;
+    _isCacheEnabled = layer._isCacheEnabled;
+    _colorMatrix = layer._colorMatrix;
+    _videoPath = layer._videoPath;
+    _video = layer._video;
+    _maskDirty = true;
+}
+
+
+const Poco::UUID& Layer::getInstanceOf() const
+{
+    return _instanceOf;
+}
+
+
 const Poco::UUID Layer::getId() const
 {
     return _id;
@@ -690,4 +1706,61 @@ bool Layer::fromJSON(const Json::Value& json, std::vector<ofPoint>& object)
 }
 
 
+std::string Layer::toString(ofBlendMode blendMode)
+{
+    switch (blendMode)
+    {
+        case OF_BLENDMODE_DISABLED:
+            return "disabled";
+        case OF_BLENDMODE_ALPHA:
+            return "alpha";
+        case OF_BLENDMODE_ADD:
+            return "add";
+        case OF_BLENDMODE_SUBTRACT:
+            return "subtract";
+        case OF_BLENDMODE_MULTIPLY:
+            return "multiply";
+        case OF_BLENDMODE_SCREEN:
+            return "screen";
+    }
+
+    return "alpha";
+}
+
+
+ofBlendMode Layer::blendModeFromString(const std::string& name)
+{
+    if ("disabled" == name) return OF_BLENDMODE_DISABLED;
+    else if ("add" == name) return OF_BLENDMODE_ADD;
+    else if ("subtract" == name) return OF_BLENDMODE_SUBTRACT;
+    else if ("multiply" == name) return OF_BLENDMODE_MULTIPLY;
+    else if ("screen" == name) return OF_BLENDMODE_SCREEN;
+    else return OF_BLENDMODE_ALPHA;
+}
+
+
+std::string Layer::toString(VideoSource::ColorMatrix colorMatrix)
+{
+    switch (colorMatrix)
+    {
+        case VideoSource::COLOR_MATRIX_BT601:
+            return "bt601";
+        case VideoSource::COLOR_MATRIX_BT709:
+            return "bt709";
+        case VideoSource::COLOR_MATRIX_AUTO:
+            return "auto";
+    }
+
+    return "auto";
+}
+
+
+VideoSource::ColorMatrix Layer::colorMatrixFromString(const std::string& name)
+{
+    if ("bt601" == name) return VideoSource::COLOR_MATRIX_BT601;
+    else if ("bt709" == name) return VideoSource::COLOR_MATRIX_BT709;
+    else return VideoSource::COLOR_MATRIX_AUTO;
+}
+
+
 } // namespace Kibio
@@ -31,9 +31,13 @@
 #include "Poco/UUIDGenerator.h"
 #include "Poco/UUID.h"
 #include "ofTypes.h"
-#include "ofVideoPlayer.h"
 #include "ofFbo.h"
 #include "ofxQuadWarp.h"
+#include "VideoSource.h"
+#include "WarpMesh.h"
+#include "MaskCoverage.h"
+#include "RenderTargetPool.h"
+#include "ResourceRegistry.h"
 
 
 namespace Kibio {
@@ -49,6 +53,56 @@ public:
     /// \brief A typedef for a shared layer.
     typedef std::shared_ptr<Layer> SharedPtr;
 
+    enum
+    {
+        /// \brief The brush size in pixels.
+        BRUSH_SIZE = 50,
+        /// \brief The maximum distance between brush stamps in pixels.
+        BRUSH_SPACING = 5,
+        /// \brief The number of surface scale steps per video size.
+        SURFACE_SCALE_STEPS = 8
+    };
+
+    /// \brief Layer composite modes.
+    enum CompositeMode
+    {
+        /// \brief The video, mask and warp are composited in a single pass
+        /// directly into the current framebuffer.
+        COMPOSITE_DIRECT,
+        /// \brief The masked video is first rendered into an intermediate
+        /// surface which is then warped into the current framebuffer.
+        COMPOSITE_SURFACE
+    };
+
+    /// \brief Per-layer colour correction, applied in the mask shader.
+    ///
+    /// Levels are applied first, then gamma, contrast around mid grey and
+    /// brightness. The lookup table, if any, is applied last.
+    struct ColorGrade
+    {
+        ColorGrade();
+
+        /// \returns true if the grade leaves colours unchanged.
+        bool isIdentity() const;
+
+        /// \brief The offset added to each channel.
+        float brightness;
+
+        /// \brief The contrast multiplier, 1 is unchanged.
+        float contrast;
+
+        /// \brief The gamma, greater than 1 brightens mid tones.
+        float gamma;
+
+        /// \brief The input levels mapped to black and white.
+        float inputBlack;
+        float inputWhite;
+
+        /// \brief The output levels black and white are mapped to.
+        float outputBlack;
+        float outputWhite;
+    };
+
     /// \brief Layer constructor.
     /// \param A reference to the layer's project.
     Layer(Project& parent);
@@ -56,9 +110,42 @@ public:
     /// \brief Destroy a layer.
     ~Layer();
 
+    /// \brief Update the layer.
+    ///
+    /// The video source is shared and updated by the project beforehand.
     void update();
+
     void draw();
 
+    /// \brief Set the layer time offset.
+    ///
+    /// Reloads the video, since sources are only shared by layers with the
+    /// same offset.
+    ///
+    /// \param offset The offset in seconds added to the project clock.
+    void setTimeOffset(double offset);
+
+    /// \returns the layer time offset in seconds.
+    double getTimeOffset() const;
+
+    /// \brief Enable caching the decoded video in memory.
+    ///
+    /// Takes effect the next time the video is loaded.
+    ///
+    /// \param cacheEnabled true to cache the video if it fits the budget.
+    void setCacheEnabled(bool cacheEnabled);
+
+    /// \returns true if caching the decoded video is enabled.
+    bool isCacheEnabled() const;
+
+    /// \brief Check if the layer changed since it was last drawn.
+    ///
+    /// A layer is dirty when a new video frame was uploaded, the mask was
+    /// edited, the warp changed or any composite setting changed.
+    ///
+    /// \returns true if the layer needs to be drawn again.
+    bool isDirty() const;
+
     /// \brief Draw the translation preview.
     /// \param mouse The mouse position.
     /// \param dragStart The position where the drag began.
@@ -84,6 +171,57 @@ public:
     /// \returns pointer to corner if mouse is inside, nullptr if not.
     const ofPoint* getHoveredCorner(const ofPoint& mouse) const;
 
+    /// \returns the four target points of the layer quad.
+    const ofPoint* getTargetPoints() const;
+
+    /// \brief Get the screen bounds of the layer.
+    ///
+    /// Bézier layers are bounded by their lattice, since the surface never
+    /// leaves the hull of its control points.
+    ///
+    /// \returns the screen bounds of the layer.
+    ofRectangle getBounds() const;
+
+    /// \brief Get the screen size of the layer relative to its video.
+    ///
+    /// Measured along the longest edges of the quad, so a perspective warp
+    /// keeps the resolution of its nearest edge.
+    ///
+    /// \returns the footprint scale, at most 1.
+    float getFootprintScale() const;
+
+    /// \brief Get the video downscale level that still covers the footprint.
+    /// \returns the number of times the video resolution can be halved.
+    int getDownscaleLevel() const;
+
+    /// \brief Check if the layer draws nothing, whatever its position.
+    /// \returns true if the layer is transparent or its mask is all black.
+    bool isHidden() const;
+
+    /// \brief Check if the layer hides everything below its quad.
+    ///
+    /// Opaque layers are fully opaque, alpha blended, unmasked planar
+    /// quads.
+    ///
+    /// \returns true if the layer is opaque.
+    bool isOpaque() const;
+
+    /// \brief Check if the layer quad contains a region.
+    /// \param bounds The region in screen space.
+    /// \returns true if the quad is convex and contains the whole region.
+    bool covers(const ofRectangle& bounds) const;
+
+    /// \returns true if the layer was visible at the last project update.
+    bool isVisible() const;
+
+    /// \brief Check if the layer can be drawn in a LayerBatch.
+    ///
+    /// Batched layers are directly composited, warped by the quad only, not
+    /// colour corrected and not being edited.
+    ///
+    /// \returns true if the layer can be batched.
+    bool isBatchable() const;
+
     /// \brief Get the centroid of the layer.
     /// \returns ofPoint shared pointer representing the centroid of the layer.
     ofPoint getCentroid() const;
@@ -91,12 +229,35 @@ public:
     /// \brief Get the screen point in layer space coordinates.
     /// \param point The point in screen space.
     /// \returns point The point in layer space.
-    ofPoint screenToLayer(const ofPoint& point); // const;
+    ofPoint screenToLayer(const ofPoint& point) const;
 
     /// \brief Get the layer point in screen space coordinates
     /// \param point point in layer space
     /// \returns point in screen space
-    ofPoint layerToScreen(const ofPoint& point); // const;
+    ofPoint layerToScreen(const ofPoint& point) const;
+
+    /// \brief Map screen points to layer space coordinates.
+    /// \param points The points in screen space.
+    /// \param result The points in layer space, may be the same as points.
+    /// \param count The number of points.
+    void screenToLayer(const ofPoint* points, ofPoint* result, std::size_t count) const;
+
+    /// \brief Map layer points to screen space coordinates.
+    /// \param points The points in layer space.
+    /// \param result The points in screen space, may be the same as points.
+    /// \param count The number of points.
+    void layerToScreen(const ofPoint* points, ofPoint* result, std::size_t count) const;
+
+    /// \brief Get the warp homography from layer to screen space.
+    ///
+    /// The matrix and its inverse are cached and solved again only after the
+    /// warp points changed.
+    ///
+    /// \returns the warp matrix.
+    const ofMatrix4x4& getMatrix() const;
+
+    /// \returns the inverse of the warp matrix, from screen to layer space.
+    const ofMatrix4x4& getMatrixInverse() const;
 
     /// \brief Load a video into the layer.
     /// \param path The path to video file.
@@ -115,6 +276,30 @@ public:
     /// \brief Clear the layer mask.
     void clearMask();
 
+    /// \brief Set how fast the temporal mask fades.
+    ///
+    /// A layer with a non-zero decay or growth has a temporal mask. It is
+    /// accumulated on the GPU from frame to frame: the previous mask fades by
+    /// the decay and the painted mask is added at the growth rate. Brush
+    /// strokes are painted into the accumulated mask, so they leave trails
+    /// that fade out, or reveal the layer for good when the decay is 0.
+    ///
+    /// \param decay The fraction of the mask lost per second in [0, 1].
+    void setMaskDecay(float decay);
+
+    /// \returns the fraction of the temporal mask lost per second.
+    float getMaskDecay() const;
+
+    /// \brief Set how fast the painted mask builds up in the temporal mask.
+    /// \param growth The fraction of the painted mask added per second.
+    void setMaskGrowth(float growth);
+
+    /// \returns the fraction of the painted mask added per second.
+    float getMaskGrowth() const;
+
+    /// \returns true if the mask is accumulated over time.
+    bool isMaskTemporal() const;
+
     /// \brief Translate the layer.
     /// \param delta The change by which to translate by expressed as a vector
     void translate(const ofPoint& delta);
@@ -127,6 +312,70 @@ public:
     /// \param mult The multiplier by which to scale by
     void scale(float mult);
 
+    /// \brief Set the composite mode.
+    /// \param mode The CompositeMode to use when drawing the layer.
+    void setCompositeMode(CompositeMode mode);
+
+    /// \returns the current CompositeMode.
+    CompositeMode getCompositeMode() const;
+
+    /// \brief Set the layer opacity.
+    /// \param opacity The opacity in the range [0, 1].
+    void setOpacity(float opacity);
+
+    /// \returns the layer opacity in the range [0, 1].
+    float getOpacity() const;
+
+    /// \brief Set the blend mode used to composite the layer.
+    /// \param blendMode The blend mode to use.
+    void setBlendMode(ofBlendMode blendMode);
+
+    /// \returns the blend mode used to composite the layer.
+    ofBlendMode getBlendMode() const;
+
+    /// \brief Set the YUV to RGB conversion matrix of the video.
+    /// \param colorMatrix The conversion matrix.
+    void setColorMatrix(VideoSource::ColorMatrix colorMatrix);
+
+    /// \returns the YUV to RGB conversion matrix of the video.
+    VideoSource::ColorMatrix getColorMatrix() const;
+
+    /// \brief Set the colour correction.
+    /// \param colorGrade The colour correction to apply.
+    void setColorGrade(const ColorGrade& colorGrade);
+
+    /// \returns the colour correction.
+    const ColorGrade& getColorGrade() const;
+
+    /// \brief Load a 3D lookup table applied after the colour correction.
+    ///
+    /// Tables are shared with all layers using the same file.
+    ///
+    /// \param path The path to a .cube file, relative to the project folder.
+    /// \returns true if loaded successfully.
+    bool loadLut(const std::string& path);
+
+    /// \brief Remove the lookup table.
+    void clearLut();
+
+    /// \returns the path of the lookup table, empty if none.
+    const std::string& getLutPath() const;
+
+    /// \returns the video texture upload timing statistics.
+    TextureUploader::Stats getUploadStats() const;
+
+    /// \brief Make the layer an instance of another layer.
+    ///
+    /// The layer shares the video source of the other layer and keeps its
+    /// own mask and warp, so both are always on the same frame.
+    ///
+    /// \param layer The layer to share the video source of.
+    void setInstanceOf(const Layer& layer);
+
+    /// \returns the id of the layer this layer is an instance of, or a null
+    ///     UUID if it is not an instance.
+    const Poco::UUID& getInstanceOf() const;
+
     const Poco::UUID getId() const;
 
     /// \brief Save the object to JSON.
@@ -151,33 +400,211 @@ public:
     /// \returns true iff deserialized successfully.
     static bool fromJSON(const Json::Value& json, std::vector<ofPoint>& object);
 
+    /// \brief Get the name of a blend mode for serialization.
+    /// \param blendMode The blend mode.
+    /// \returns the name of the blend mode.
+    static std::string toString(ofBlendMode blendMode);
+
+    /// \brief Get a blend mode from its serialized name.
+    /// \param name The name of the blend mode.
+    /// \returns the blend mode or OF_BLENDMODE_ALPHA if unknown.
+    static ofBlendMode blendModeFromString(const std::string& name);
+
+    /// \brief Get the name of a color matrix for serialization.
+    /// \param colorMatrix The color matrix.
+    /// \returns the name of the color matrix.
+    static std::string toString(VideoSource::ColorMatrix colorMatrix);
+
+    /// \brief Get a color matrix from its serialized name.
+    /// \param name The name of the color matrix.
+    /// \returns the color matrix or COLOR_MATRIX_AUTO if unknown.
+    static VideoSource::ColorMatrix colorMatrixFromString(const std::string& name);
+
 private:
+    /// \returns true if the layer needs an intermediate surface.
+    bool needsSurface() const;
+
+    /// \brief Set the colour correction uniforms and bind the lookup table.
+    ///
+    /// Must be called while the mask shader is bound.
+    void beginColorGrade() const;
+
+    /// \brief Unbind the lookup table.
+    void endColorGrade() const;
+
+    /// \brief Accumulate the temporal mask for this frame.
+    void updateTemporalMask();
+
+    /// \returns the mask the layer is drawn with.
+    const ofTexture& getMaskTexture() const;
+
+    /// \returns the framebuffer holding the mask the layer is drawn with.
+    const ofFbo& getMaskFbo() const;
+
+    /// \returns true if the mask is not plain white.
+    bool hasMask() const;
+
+    /// \returns true if the loaded mask texture is all black.
+    bool isMaskTextureBlack() const;
+
+    /// \brief Give the mask a new version after it changed.
+    void touchMask();
+
+    /// \brief Analyse the painted mask into the coverage grid.
+    ///
+    /// Reads the mask back once, so it is only called when a mask was
+    /// loaded or a brush stroke ended.
+    void updateMaskCoverage();
+
+    /// \brief Draw the layer geometry, skipping empty mask tiles.
+    ///
+    /// Full tiles are skipped too if drawOpaqueTiles() already drew them
+    /// this frame.
+    void drawGeometry() const;
+
+    /// \brief Check if the full mask tiles can be drawn before all layers.
+    /// \returns true if the full tiles are opaque on screen.
+    bool isOpaqueDrawable() const;
+
+    /// \brief Draw the full mask tiles without blending.
+    ///
+    /// The following draw() only draws the remaining tiles.
+    void drawOpaqueTiles();
+
     Project& _parent;
     Poco::UUID _id;
 
-    ofFbo _surface;
+    /// \brief The id of the layer whose video source is shared, or null.
+    Poco::UUID _instanceOf;
+
+    /// \brief An intermediate surface from the RenderTargetPool, only held
+    /// when needsSurface().
+    RenderTargetPool::Target _surface;
+
+    /// \brief The scale of the video in the surface, in steps of
+    /// 1 / SURFACE_SCALE_STEPS.
+    float _surfaceScale;
+
+    /// \brief The single channel mask.
     ofFbo _maskSurface;
 
+    /// \brief The ping-pong targets of the temporal mask, only allocated
+    /// when isMaskTemporal().
+    ofFbo _temporalMasks[2];
+
+    /// \brief The index of the current temporal mask.
+    std::size_t _temporalMask;
+
+    /// \brief The fraction of the temporal mask lost per second.
+    float _maskDecay;
+
+    /// \brief The fraction of the painted mask added per second.
+    float _maskGrowth;
+
+    /// \brief true while the painted mask is plain white.
+    bool _isMaskBlank;
+
+    /// \brief true while the painted mask is known to be all black.
+    bool _isMaskBlack;
+
+    /// \brief true if the layer was visible at the last project update.
+    bool _isVisible;
+
+    /// \brief The coverage grid of the painted mask.
+    MaskCoverage _maskCoverage;
+
+    /// \brief true if drawOpaqueTiles() drew the full tiles this frame.
+    bool _isOpaqueDrawn;
+
+    /// \brief The mask version, unique among all layers.
+    uint64_t _maskVersion;
+
+    /// \brief The last mask version handed out.
+    static uint64_t _maskVersionCount;
+
+    CompositeMode _compositeMode;
+    float _opacity;
+    ofBlendMode _blendMode;
+    VideoSource::ColorMatrix _colorMatrix;
+    ColorGrade _colorGrade;
+
     ofColor _color;
     ofColor _highlightColor;
 
     std::string _videoPath;
     std::string _maskPath;
+    std::string _lutPath;
+
+    VideoSource::SharedPtr _video;
+
+    /// \brief The offset in seconds added to the project clock.
+    double _timeOffset;
 
-    std::shared_ptr<ofVideoPlayer> _video;
+    /// \brief true if the decoded video should be cached in memory.
+    bool _isCacheEnabled;
     std::shared_ptr<ofTexture> _mask;
 
+    /// \brief The lookup table, shared by all layers using the same file.
+    std::shared_ptr<Lut3D> _lut;
+
     bool _maskDirty;
 
+    /// \brief true if the layer changed since it was last drawn.
+    bool _isDirty;
+
+    /// \brief true if the intermediate surface must be rendered again.
+    bool _surfaceDirty;
+
+    /// \brief The warp source points when the layer was last updated.
+    ofPoint _lastSourcePoints[4];
+
+    /// \brief The warp target points when the layer was last updated.
+    ofPoint _lastTargetPoints[4];
+
     /// \brief The quad warper.
     ofxQuadWarp _warper;
 
-    ofTexture _brushTex;
+    /// \brief The warp grid, drawn under the warp matrix.
+    WarpMesh _warpMesh;
+
+    /// \brief Solve the warp matrices again if the warp points changed.
+    void updateMatrices() const;
+
+    /// \brief The cached warp matrix.
+    mutable ofMatrix4x4 _matrix;
+
+    /// \brief The cached inverse warp matrix.
+    mutable ofMatrix4x4 _matrixInverse;
+
+    /// \brief The warp source points the matrices were solved for.
+    mutable ofPoint _matrixSourcePoints[4];
+
+    /// \brief The warp target points the matrices were solved for.
+    mutable ofPoint _matrixTargetPoints[4];
+
+    /// \brief true once the matrices were solved.
+    mutable bool _isMatrixValid;
+
+    /// \brief The screen position of the brush in the last frame.
+    ofPoint _lastBrushPoint;
+
+    /// \brief true while a brush stroke is in progress.
+    bool _isBrushing;
+
+    /// \brief Reused storage for the brush stamps of a frame.
+    std::vector<ofPoint> _brushStamps;
+
+    /// \brief The brush, shared by all layers.
+    std::shared_ptr<ofTexture> _brushTex;
+
+    /// \brief The mask shader, shared by all layers.
+    std::shared_ptr<ofShader> _maskShader;
 
-    ofShader _maskShader;
-    ofShader _frameCombineShader;
+    /// \brief The frame combine shader, shared by all layers.
+    std::shared_ptr<ofShader> _frameCombineShader;
 
     friend class Project;
+    friend class LayerBatch;
 };
 
 
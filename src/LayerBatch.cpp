@@ -0,0 +1,297 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "LayerBatch.h"
+#include "Layer.h"
+#include "ResourceRegistry.h"
+#include "ofGraphics.h"
+#include "ofLog.h"
+
+
+namespace Kibio {
+
+
+LayerBatch::LayerBatch():
+    _blendMode(OF_BLENDMODE_ALPHA),
+    _isCovered(false),
+    _instanceCapacity(0),
+    _maskArray(0),
+    _maskWidth(0),
+    _maskHeight(0),
+    _maskCapacity(0)
+{
+    _shader = ResourceRegistry::getDefault().getShader("shaders/GL3/batch");
+
+    // Samplers of different types must never share a texture unit.
+    _shader->begin();
+    _shader->setUniform1i("maskTex", 1);
+    _shader->setUniform1i("uvTex", 2);
+    _shader->setUniform1i("vTex", 3);
+    _shader->setUniform1i("compressedTex", 4);
+    _shader->setUniform1i("instanceTex", 5);
+    _shader->end();
+}
+
+
+LayerBatch::~LayerBatch()
+{
+    if (_maskArray != 0)
+    {
+        glDeleteTextures(1, &_maskArray);
+    }
+}
+
+
+void LayerBatch::begin(const VideoSource::SharedPtr& source, ofBlendMode blendMode)
+{
+    clear();
+    _source = source;
+    _blendMode = blendMode;
+}
+
+
+void LayerBatch::clear()
+{
+    _source.reset();
+    _layers.clear();
+    _isCovered = false;
+}
+
+
+bool LayerBatch::canAdd(const Layer& layer, const ofRectangle& bounds) const
+{
+    return layer._video == _source &&
+           layer._blendMode == _blendMode &&
+           _layers.size() < MAX_INSTANCES &&
+           !(_isCovered && _covered.intersects(bounds));
+}
+
+
+void LayerBatch::add(Layer& layer)
+{
+    _layers.push_back(&layer);
+}
+
+
+void LayerBatch::cover(const ofRectangle& bounds)
+{
+    if (_isCovered)
+    {
+        _covered.growToInclude(bounds);
+    }
+    else
+    {
+        _covered = bounds;
+        _isCovered = true;
+    }
+}
+
+
+std::size_t LayerBatch::size() const
+{
+    return _layers.size();
+}
+
+
+Layer* LayerBatch::getLayer(std::size_t index) const
+{
+    return _layers[index];
+}
+
+
+void LayerBatch::draw()
+{
+    if (_layers.empty())
+    {
+        return;
+    }
+
+    if (_layers.size() == 1)
+    {
+        _layers[0]->draw();
+        return;
+    }
+
+    _quad.update(_source->getWidth(), _source->getHeight());
+
+    updateMasks();
+
+    _instances.resize(_layers.size() * TEXELS_PER_INSTANCE * 4);
+
+    float maskSlice = 0;
+
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        Layer& layer = *_layers[i];
+        float* instance = &_instances[i * TEXELS_PER_INSTANCE * 4];
+
+        // ofMatrix4x4 is stored in OpenGL order, four columns of four.
+        std::copy(layer.getMatrix().getPtr(), layer.getMatrix().getPtr() + 16, instance);
+
+        instance[16] = layer.hasMask() ? maskSlice++ : -1;
+        instance[17] = layer._opacity;
+        instance[18] = 0;
+        instance[19] = 0;
+
+        layer._surfaceDirty = false;
+        layer._isDirty = false;
+    }
+
+    if (_instanceCapacity < _layers.size())
+    {
+        _instanceCapacity = MAX_INSTANCES;
+        _instanceBuffer.allocate(_instanceCapacity * TEXELS_PER_INSTANCE * 4 * sizeof(float), GL_STREAM_DRAW);
+        _instanceTexture.allocateAsBufferTexture(_instanceBuffer, GL_RGBA32F);
+    }
+
+    _instanceBuffer.updateData(0, _instances.size() * sizeof(float), &_instances[0]);
+
+    ofPushStyle();
+    ofEnableBlendMode(_blendMode);
+
+    _shader->begin();
+    _shader->setUniformTexture("instanceTex", _instanceTexture, 5);
+    _shader->setUniform2f("maskScale", 1.0f / _source->getWidth(), 1.0f / _source->getHeight());
+
+    glActiveTexture(GL_TEXTURE0 + 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _maskArray);
+    glActiveTexture(GL_TEXTURE0);
+
+    _source->setShaderUniforms(*_shader);
+    _quad.drawInstanced(_layers.size());
+
+    glActiveTexture(GL_TEXTURE0 + 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    _shader->end();
+
+    ofPopStyle();
+}
+
+
+void LayerBatch::updateMasks()
+{
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        if (_layers[i]->hasMask())
+        {
+            ++count;
+        }
+    }
+
+    if (0 == count)
+    {
+        return;
+    }
+
+    float width = _source->getWidth();
+    float height = _source->getHeight();
+
+    if (0 == _maskArray || count > _maskCapacity || width != _maskWidth || height != _maskHeight)
+    {
+        // Grow in powers of two so adding layers rarely reallocates.
+        std::size_t capacity = 4;
+
+        while (capacity < count)
+        {
+            capacity *= 2;
+        }
+
+        if (0 == _maskArray)
+        {
+            glGenTextures(1, &_maskArray);
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _maskArray);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, width, height, capacity, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        ofLogVerbose("LayerBatch::updateMasks") << "Allocated " << capacity << " mask slices of " << width << " x " << height;
+
+        _maskWidth = width;
+        _maskHeight = height;
+        _maskCapacity = capacity;
+        _slices.assign(capacity, std::pair<const Layer*, uint64_t>(nullptr, 0));
+    }
+
+    // Copy only the masks that changed or moved to another slice. Copies
+    // stay on the GPU.
+    std::size_t slice = 0;
+    bool isBound = false;
+
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        const Layer& layer = *_layers[i];
+
+        if (!layer.hasMask())
+        {
+            continue;
+        }
+
+        std::pair<const Layer*, uint64_t> key(&layer, layer._maskVersion);
+
+        if (_slices[slice] != key)
+        {
+            const ofFbo& mask = layer.getMaskFbo();
+
+            if (!isBound)
+            {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, _maskArray);
+                isBound = true;
+            }
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, mask.getId());
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                                0,
+                                0,
+                                0,
+                                slice,
+                                0,
+                                0,
+                                std::min(mask.getWidth(), width),
+                                std::min(mask.getHeight(), height));
+            _slices[slice] = key;
+        }
+
+        ++slice;
+    }
+
+    if (isBound)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+}
+
+
+} // namespace Kibio
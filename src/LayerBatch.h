@@ -0,0 +1,172 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofBufferObject.h"
+#include "ofRectangle.h"
+#include "ofShader.h"
+#include "ofTexture.h"
+#include "VideoSource.h"
+#include "WarpMesh.h"
+
+
+namespace Kibio {
+
+
+class Layer;
+
+
+/// \brief Draws many layers that share a video source in one draw call.
+///
+/// Pixel mapping projects often show hundreds of small instances of the
+/// same video. Drawn one by one, each layer binds its shader, textures and
+/// style and the frame is bound by driver overhead. A batch instead keeps
+/// the per-layer warp matrix, opacity and mask slice in a texture buffer,
+/// the masks in a 2D texture array, and draws all of its layers as
+/// instances of one quad.
+///
+/// Instances are drawn in the order they were added, so a batch keeps the
+/// z-order of its layers. A layer may only join a batch that was started
+/// earlier in the z-order if it does not overlap anything drawn in between.
+///
+/// Masks are only copied into the array when they change, and layers
+/// without a mask take no slice at all.
+class LayerBatch
+{
+public:
+    /// \brief Create an empty LayerBatch.
+    LayerBatch();
+
+    /// \brief Destroy the LayerBatch, deleting its mask array.
+    ~LayerBatch();
+
+    /// \brief Start a new batch for a source, removing all layers.
+    /// \param source The video source shared by the layers.
+    /// \param blendMode The blend mode shared by the layers.
+    void begin(const VideoSource::SharedPtr& source, ofBlendMode blendMode);
+
+    /// \brief Remove all layers and release the source.
+    void clear();
+
+    /// \brief Check if a layer can be added to the batch.
+    /// \param layer The layer, which must be batchable.
+    /// \param bounds The screen bounds of the layer.
+    /// \returns true if the layer shares the source and blend mode and does
+    ///     not overlap anything drawn since the batch was started.
+    bool canAdd(const Layer& layer, const ofRectangle& bounds) const;
+
+    /// \brief Add a layer to the batch.
+    /// \param layer The layer to add.
+    void add(Layer& layer);
+
+    /// \brief Record a region drawn after the batch in z-order.
+    ///
+    /// Layers overlapping any covered region can no longer join the batch.
+    ///
+    /// \param bounds The screen bounds of a layer drawn after the batch.
+    void cover(const ofRectangle& bounds);
+
+    /// \returns the number of layers in the batch.
+    std::size_t size() const;
+
+    /// \brief Get a layer in the batch.
+    /// \param index The index of the layer, in z-order.
+    /// \returns the layer.
+    Layer* getLayer(std::size_t index) const;
+
+    /// \brief Draw all layers in the batch.
+    ///
+    /// A batch of a single layer simply draws the layer.
+    void draw();
+
+    enum
+    {
+        /// \brief The maximum number of layers in a batch.
+        MAX_INSTANCES = 256,
+        /// \brief The number of RGBA texels per instance: four warp matrix
+        /// columns and the mask slice and opacity.
+        TEXELS_PER_INSTANCE = 5
+    };
+
+private:
+    LayerBatch(const LayerBatch&);
+    LayerBatch& operator = (const LayerBatch&);
+
+    /// \brief Copy the changed masks into the mask array.
+    void updateMasks();
+
+    /// \brief The shared video source.
+    VideoSource::SharedPtr _source;
+
+    /// \brief The shared blend mode.
+    ofBlendMode _blendMode;
+
+    /// \brief The layers in z-order.
+    std::vector<Layer*> _layers;
+
+    /// \brief The union of the bounds drawn after the batch was started.
+    ofRectangle _covered;
+
+    /// \brief true if anything was drawn after the batch was started.
+    bool _isCovered;
+
+    /// \brief The instance data, TEXELS_PER_INSTANCE RGBA texels per layer.
+    std::vector<float> _instances;
+
+    /// \brief The instance data on the GPU.
+    ofBufferObject _instanceBuffer;
+
+    /// \brief The instance buffer as a texture buffer.
+    ofTexture _instanceTexture;
+
+    /// \brief The number of instances the buffer is allocated for.
+    std::size_t _instanceCapacity;
+
+    /// \brief The mask array texture id, 0 until a masked layer is added.
+    GLuint _maskArray;
+
+    /// \brief The size of each mask slice in pixels.
+    float _maskWidth;
+    float _maskHeight;
+
+    /// \brief The number of slices the mask array is allocated for.
+    std::size_t _maskCapacity;
+
+    /// \brief The layer and mask version held by each slice.
+    std::vector<std::pair<const Layer*, uint64_t> > _slices;
+
+    /// \brief The quad drawn for each instance.
+    WarpMesh _quad;
+
+    /// \brief The batch shader, shared by all batches.
+    std::shared_ptr<ofShader> _shader;
+
+};
+
+
+} // namespace Kibio
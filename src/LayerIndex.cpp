@@ -0,0 +1,485 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "LayerIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define KIBIO_LAYER_INDEX_SSE 1
+#include <xmmintrin.h>
+#endif
+
+
+namespace Kibio {
+
+
+LayerIndex::LayerIndex(const LayerStore& store):
+    _store(store),
+    _size(0)
+{
+}
+
+
+void LayerIndex::clear()
+{
+    _entries.clear();
+    _cells.clear();
+    _largeEntries.clear();
+    _size = 0;
+}
+
+
+void LayerIndex::add(LayerStore::Handle handle)
+{
+    const Layer::SharedPtr& layer = _store.get(handle);
+
+    if (!layer)
+    {
+        return;
+    }
+
+    std::size_t slot = LayerStore::getSlot(handle);
+
+    if (slot >= _entries.size())
+    {
+        Entry empty;
+        empty.handle = LayerStore::INVALID_HANDLE;
+        _entries.resize(slot + 1, empty);
+    }
+
+    if (_entries[slot].handle != LayerStore::INVALID_HANDLE)
+    {
+        removeCells(slot);
+        --_size;
+    }
+
+    Entry& entry = _entries[slot];
+    entry.handle = handle;
+    setPoints(entry, layer->getTargetPoints());
+
+    insertCells(slot);
+    ++_size;
+}
+
+
+void LayerIndex::remove(LayerStore::Handle handle)
+{
+    std::size_t slot = LayerStore::getSlot(handle);
+
+    if (slot < _entries.size() && _entries[slot].handle == handle)
+    {
+        removeCells(slot);
+        _entries[slot].handle = LayerStore::INVALID_HANDLE;
+        --_size;
+    }
+}
+
+
+void LayerIndex::update(LayerStore::Handle handle)
+{
+    std::size_t slot = LayerStore::getSlot(handle);
+
+    if (slot >= _entries.size() || _entries[slot].handle != handle)
+    {
+        return;
+    }
+
+    const Layer::SharedPtr& layer = _store.get(handle);
+
+    if (!layer)
+    {
+        return;
+    }
+
+    Entry& entry = _entries[slot];
+
+    const ofPoint* points = layer->getTargetPoints();
+
+    bool isChanged = false;
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        if (entry.x[i] != points[i].x || entry.y[i] != points[i].y)
+        {
+            isChanged = true;
+            break;
+        }
+    }
+
+    if (isChanged)
+    {
+        removeCells(slot);
+        setPoints(entry, points);
+        insertCells(slot);
+    }
+}
+
+
+LayerStore::Handle LayerIndex::getLayerAtPoint(const ofPoint& point) const
+{
+    findCandidates(point);
+
+    std::size_t offset = 0;
+
+    while (offset < _candidates.size())
+    {
+        const Entry& entry = _entries[_candidates[offset].second];
+
+        if (!entry.isConvex)
+        {
+            if (contains(entry, point) && !isCornerAtPoint(entry, point))
+            {
+                return entry.handle;
+            }
+
+            ++offset;
+            continue;
+        }
+
+        // Test a run of up to four convex quads at once.
+        const Entry* convex[4];
+        std::size_t numConvex = 0;
+
+        while (offset < _candidates.size() &&
+               numConvex < 4 &&
+               _entries[_candidates[offset].second].isConvex)
+        {
+            convex[numConvex++] = &_entries[_candidates[offset++].second];
+        }
+
+        int mask = containsConvex(convex, numConvex, point);
+
+        // The candidates are top first, so the lowest bit wins.
+        for (std::size_t i = 0; i < numConvex; ++i)
+        {
+            if ((mask & (1 << i)) && !isCornerAtPoint(*convex[i], point))
+            {
+                return convex[i]->handle;
+            }
+        }
+    }
+
+    return LayerStore::INVALID_HANDLE;
+}
+
+
+bool LayerIndex::isCornerAtPoint(const ofPoint& point) const
+{
+    findCandidates(point);
+
+    for (std::size_t i = 0; i < _candidates.size(); ++i)
+    {
+        if (isCornerAtPoint(_entries[_candidates[i].second], point))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+std::size_t LayerIndex::size() const
+{
+    return _size;
+}
+
+
+void LayerIndex::setPoints(Entry& entry, const ofPoint* points)
+{
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxX = -std::numeric_limits<float>::max();
+    float maxY = -std::numeric_limits<float>::max();
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        entry.x[i] = points[i].x;
+        entry.y[i] = points[i].y;
+
+        minX = std::min(minX, entry.x[i]);
+        minY = std::min(minY, entry.y[i]);
+        maxX = std::max(maxX, entry.x[i]);
+        maxY = std::max(maxY, entry.y[i]);
+    }
+
+    // Grow the bounds so that the cells also cover the corner handles.
+    entry.minCellX = toCell(minX - CORNER_RADIUS);
+    entry.minCellY = toCell(minY - CORNER_RADIUS);
+    entry.maxCellX = toCell(maxX + CORNER_RADIUS);
+    entry.maxCellY = toCell(maxY + CORNER_RADIUS);
+
+    int64_t numCells = int64_t(entry.maxCellX - entry.minCellX + 1) *
+                       int64_t(entry.maxCellY - entry.minCellY + 1);
+
+    entry.isLarge = numCells > MAX_CELLS_PER_LAYER;
+
+    // Strictly convex if every turn has the same sign.
+    int numPositive = 0;
+    int numNegative = 0;
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        std::size_t j = (i + 1) % 4;
+        std::size_t k = (i + 2) % 4;
+
+        float cross = (entry.x[j] - entry.x[i]) * (entry.y[k] - entry.y[j]) -
+                      (entry.y[j] - entry.y[i]) * (entry.x[k] - entry.x[j]);
+
+        if (cross > 0)
+        {
+            ++numPositive;
+        }
+        else if (cross < 0)
+        {
+            ++numNegative;
+        }
+    }
+
+    entry.isConvex = (numPositive == 4 || numNegative == 4);
+}
+
+
+void LayerIndex::insertCells(std::size_t slot)
+{
+    const Entry& entry = _entries[slot];
+
+    if (entry.isLarge)
+    {
+        _largeEntries.push_back(slot);
+        return;
+    }
+
+    for (int y = entry.minCellY; y <= entry.maxCellY; ++y)
+    {
+        for (int x = entry.minCellX; x <= entry.maxCellX; ++x)
+        {
+            _cells[getCellKey(x, y)].push_back(slot);
+        }
+    }
+}
+
+
+void LayerIndex::removeCells(std::size_t slot)
+{
+    const Entry& entry = _entries[slot];
+
+    if (entry.isLarge)
+    {
+        _largeEntries.erase(std::find(_largeEntries.begin(),
+                                      _largeEntries.end(),
+                                      slot));
+        return;
+    }
+
+    for (int y = entry.minCellY; y <= entry.maxCellY; ++y)
+    {
+        for (int x = entry.minCellX; x <= entry.maxCellX; ++x)
+        {
+            std::unordered_map<int64_t, std::vector<std::size_t> >::iterator iter = _cells.find(getCellKey(x, y));
+
+            if (iter != _cells.end())
+            {
+                std::vector<std::size_t>& cell = iter->second;
+                std::vector<std::size_t>::iterator found = std::find(cell.begin(), cell.end(), slot);
+
+                if (found != cell.end())
+                {
+                    // Cells are unordered, so removal is a swap and pop.
+                    *found = cell.back();
+                    cell.pop_back();
+                }
+
+                if (cell.empty())
+                {
+                    _cells.erase(iter);
+                }
+            }
+        }
+    }
+}
+
+
+void LayerIndex::findCandidates(const ofPoint& point) const
+{
+    _candidates.clear();
+
+    std::unordered_map<int64_t, std::vector<std::size_t> >::const_iterator iter = _cells.find(getCellKey(toCell(point.x), toCell(point.y)));
+
+    if (iter != _cells.end())
+    {
+        for (std::size_t i = 0; i < iter->second.size(); ++i)
+        {
+            std::size_t slot = iter->second[i];
+            _candidates.push_back(std::make_pair(_store.getDepth(_entries[slot].handle), slot));
+        }
+    }
+
+    for (std::size_t i = 0; i < _largeEntries.size(); ++i)
+    {
+        std::size_t slot = _largeEntries[i];
+        _candidates.push_back(std::make_pair(_store.getDepth(_entries[slot].handle), slot));
+    }
+
+    // Top first, in the current stacking order of the store.
+    std::sort(_candidates.begin(),
+              _candidates.end(),
+              std::greater<std::pair<std::size_t, std::size_t> >());
+}
+
+
+int LayerIndex::containsConvex(const Entry* const* entries,
+                               std::size_t count,
+                               const ofPoint& point)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int laneMask = (1 << count) - 1;
+
+#if defined(KIBIO_LAYER_INDEX_SSE)
+    // Pad the unused lanes with the first entry, they are masked off below.
+    const Entry* e[4] = {
+        entries[0],
+        entries[count > 1 ? 1 : 0],
+        entries[count > 2 ? 2 : 0],
+        entries[count > 3 ? 3 : 0]
+    };
+
+    __m128 px = _mm_set1_ps(point.x);
+    __m128 py = _mm_set1_ps(point.y);
+    __m128 minCross = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 maxCross = _mm_set1_ps(-std::numeric_limits<float>::max());
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        std::size_t j = (i + 1) % 4;
+
+        __m128 xi = _mm_setr_ps(e[0]->x[i], e[1]->x[i], e[2]->x[i], e[3]->x[i]);
+        __m128 yi = _mm_setr_ps(e[0]->y[i], e[1]->y[i], e[2]->y[i], e[3]->y[i]);
+        __m128 xj = _mm_setr_ps(e[0]->x[j], e[1]->x[j], e[2]->x[j], e[3]->x[j]);
+        __m128 yj = _mm_setr_ps(e[0]->y[j], e[1]->y[j], e[2]->y[j], e[3]->y[j]);
+
+        // The side of each edge the point is on.
+        __m128 cross = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(xj, xi), _mm_sub_ps(py, yi)),
+                                  _mm_mul_ps(_mm_sub_ps(yj, yi), _mm_sub_ps(px, xi)));
+
+        minCross = _mm_min_ps(minCross, cross);
+        maxCross = _mm_max_ps(maxCross, cross);
+    }
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 inside = _mm_or_ps(_mm_cmpge_ps(minCross, zero),
+                              _mm_cmple_ps(maxCross, zero));
+
+    return _mm_movemask_ps(inside) & laneMask;
+#else
+    int mask = 0;
+
+    for (std::size_t n = 0; n < count; ++n)
+    {
+        const Entry& entry = *entries[n];
+
+        float minCross = std::numeric_limits<float>::max();
+        float maxCross = -std::numeric_limits<float>::max();
+
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            std::size_t j = (i + 1) % 4;
+
+            float cross = (entry.x[j] - entry.x[i]) * (point.y - entry.y[i]) -
+                          (entry.y[j] - entry.y[i]) * (point.x - entry.x[i]);
+
+            minCross = std::min(minCross, cross);
+            maxCross = std::max(maxCross, cross);
+        }
+
+        if (minCross >= 0 || maxCross <= 0)
+        {
+            mask |= 1 << n;
+        }
+    }
+
+    return mask & laneMask;
+#endif
+}
+
+
+bool LayerIndex::contains(const Entry& entry, const ofPoint& point)
+{
+    bool isInside = false;
+
+    for (std::size_t i = 0, j = 3; i < 4; j = i++)
+    {
+        if ((entry.y[i] > point.y) != (entry.y[j] > point.y) &&
+            point.x < (entry.x[j] - entry.x[i]) * (point.y - entry.y[i]) / (entry.y[j] - entry.y[i]) + entry.x[i])
+        {
+            isInside = !isInside;
+        }
+    }
+
+    return isInside;
+}
+
+
+bool LayerIndex::isCornerAtPoint(const Entry& entry, const ofPoint& point)
+{
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        float dx = entry.x[i] - point.x;
+        float dy = entry.y[i] - point.y;
+
+        if (dx * dx + dy * dy <= CORNER_RADIUS * CORNER_RADIUS)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+int64_t LayerIndex::getCellKey(int x, int y)
+{
+    return (int64_t(x) << 32) | uint32_t(y);
+}
+
+
+int LayerIndex::toCell(float value)
+{
+    // Clamp so that far away quads do not overflow the cell coordinates.
+    float cell = std::floor(value / CELL_SIZE);
+    return int(std::max(-1e6f, std::min(1e6f, cell)));
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,186 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <unordered_map>
+#include <vector>
+#include "ofTypes.h"
+#include "LayerStore.h"
+
+
+namespace Kibio {
+
+
+/// \brief A uniform grid over the target quads of the layers.
+///
+/// Picking the layer under a point only tests the layers whose quad bounds
+/// overlap the grid cell of the point, four quads at a time. Layers are
+/// indexed by handle and re-bucketed individually when their target points
+/// change. The stacking order is read from the store, so reordering layers
+/// does not touch the index.
+class LayerIndex
+{
+public:
+    /// \brief Create an empty LayerIndex.
+    /// \param store The layers to index.
+    LayerIndex(const LayerStore& store);
+
+    /// \brief Remove all layers.
+    void clear();
+
+    /// \brief Add a layer of the store.
+    /// \param handle The handle of the layer to add.
+    void add(LayerStore::Handle handle);
+
+    /// \brief Remove a layer, before it is removed from the store.
+    /// \param handle The handle of the layer to remove.
+    void remove(LayerStore::Handle handle);
+
+    /// \brief Re-bucket a layer if its target points changed.
+    /// \param handle The handle of the indexed layer to update.
+    void update(LayerStore::Handle handle);
+
+    /// \brief Get the top layer containing a point.
+    ///
+    /// Layers are skipped where the point is on one of their corners, which
+    /// matches Layer::hitTest().
+    ///
+    /// \param point The point to test.
+    /// \returns the handle of the layer or LayerStore::INVALID_HANDLE.
+    LayerStore::Handle getLayerAtPoint(const ofPoint& point) const;
+
+    /// \brief Determine if any layer corner is at a point.
+    /// \param point The point to test.
+    /// \returns true if a corner is within CORNER_RADIUS of the point.
+    bool isCornerAtPoint(const ofPoint& point) const;
+
+    /// \returns the number of indexed layers.
+    std::size_t size() const;
+
+    enum
+    {
+        /// \brief The grid cell size in pixels.
+        CELL_SIZE = 128,
+        /// \brief The corner hover radius in pixels, see Layer::getHoveredCorner().
+        CORNER_RADIUS = 5,
+        /// \brief Layers spanning more cells are tested for every point.
+        MAX_CELLS_PER_LAYER = 256
+    };
+
+private:
+    /// \brief An indexed layer.
+    struct Entry
+    {
+        /// \brief The layer handle or LayerStore::INVALID_HANDLE.
+        LayerStore::Handle handle;
+
+        /// \brief The target point x coordinates.
+        float x[4];
+
+        /// \brief The target point y coordinates.
+        float y[4];
+
+        /// \brief The first and last cells covered, inclusive.
+        int minCellX;
+        int minCellY;
+        int maxCellX;
+        int maxCellY;
+
+        /// \brief true if the entry is in the large entry list instead of cells.
+        bool isLarge;
+
+        /// \brief true if the quad is strictly convex.
+        bool isConvex;
+    };
+
+    /// \brief Copy the target points of a layer and compute its cells.
+    /// \param entry The entry to set.
+    /// \param points The target points of the layer.
+    static void setPoints(Entry& entry, const ofPoint* points);
+
+    /// \brief Add an entry to its cells.
+    /// \param slot The entry slot.
+    void insertCells(std::size_t slot);
+
+    /// \brief Remove an entry from its cells.
+    /// \param slot The entry slot.
+    void removeCells(std::size_t slot);
+
+    /// \brief Collect the entries that might contain a point, top first.
+    /// \param point The point.
+    void findCandidates(const ofPoint& point) const;
+
+    /// \brief Test up to four convex entries at once.
+    /// \param entries The entries to test.
+    /// \param count The number of entries, at most 4.
+    /// \param point The point to test.
+    /// \returns a bit mask of the entries containing the point.
+    static int containsConvex(const Entry* const* entries,
+                              std::size_t count,
+                              const ofPoint& point);
+
+    /// \brief Test one entry with a crossing test.
+    /// \param entry The entry to test.
+    /// \param point The point to test.
+    /// \returns true if the quad contains the point.
+    static bool contains(const Entry& entry, const ofPoint& point);
+
+    /// \brief Determine if a point is on a corner of an entry.
+    /// \param entry The entry to test.
+    /// \param point The point to test.
+    /// \returns true if a corner is within CORNER_RADIUS of the point.
+    static bool isCornerAtPoint(const Entry& entry, const ofPoint& point);
+
+    /// \returns the key of a grid cell.
+    static int64_t getCellKey(int x, int y);
+
+    /// \returns the grid cell of a coordinate.
+    static int toCell(float value);
+
+    /// \brief The indexed layers.
+    const LayerStore& _store;
+
+    /// \brief The entries by layer slot.
+    std::vector<Entry> _entries;
+
+    /// \brief The number of indexed layers.
+    std::size_t _size;
+
+    /// \brief The entry slots overlapping each cell.
+    std::unordered_map<int64_t, std::vector<std::size_t> > _cells;
+
+    /// \brief The entry slots too large for the grid.
+    std::vector<std::size_t> _largeEntries;
+
+    /// \brief Reused storage for the depth and slot of query candidates.
+    mutable std::vector<std::pair<std::size_t, std::size_t> > _candidates;
+
+};
+
+
+} // namespace Kibio
@@ -0,0 +1,266 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "LayerStore.h"
+#include <algorithm>
+
+
+namespace Kibio {
+
+
+const LayerStore::Handle LayerStore::INVALID_HANDLE = 0;
+
+
+LayerStore::LayerStore()
+{
+}
+
+
+LayerStore::Handle LayerStore::add(const Layer::SharedPtr& layer)
+{
+    std::size_t slot = 0;
+
+    if (_freeSlots.empty())
+    {
+        slot = _generations.size();
+        // Generations start at 1 so that no handle equals INVALID_HANDLE.
+        _generations.push_back(1);
+        _depths.push_back(0);
+    }
+    else
+    {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+
+    Handle handle = (Handle(_generations[slot]) << 32) | Handle(slot);
+
+    _depths[slot] = _layers.size();
+    _layers.push_back(layer);
+    _handles.push_back(handle);
+    _ids[layer->getId()] = handle;
+
+    return handle;
+}
+
+
+void LayerStore::remove(Handle handle)
+{
+    if (!isValid(handle))
+    {
+        return;
+    }
+
+    std::size_t slot = getSlot(handle);
+    std::size_t depth = _depths[slot];
+
+    std::map<Poco::UUID, Handle>::iterator id = _ids.find(_layers[depth]->getId());
+
+    if (id != _ids.end() && id->second == handle)
+    {
+        _ids.erase(id);
+    }
+
+    // Move to the top so that the removal does not shift any other layer.
+    move(depth, _layers.size() - 1);
+
+    _layers.pop_back();
+    _handles.pop_back();
+
+    ++_generations[slot];
+    _freeSlots.push_back(slot);
+}
+
+
+void LayerStore::clear()
+{
+    for (std::size_t i = 0; i < _handles.size(); ++i)
+    {
+        std::size_t slot = getSlot(_handles[i]);
+        ++_generations[slot];
+        _freeSlots.push_back(slot);
+    }
+
+    _layers.clear();
+    _handles.clear();
+    _ids.clear();
+}
+
+
+bool LayerStore::isValid(Handle handle) const
+{
+    std::size_t slot = getSlot(handle);
+
+    return handle != INVALID_HANDLE &&
+           slot < _generations.size() &&
+           _generations[slot] == uint32_t(handle >> 32);
+}
+
+
+const Layer::SharedPtr& LayerStore::get(Handle handle) const
+{
+    static const Layer::SharedPtr empty;
+
+    if (!isValid(handle))
+    {
+        return empty;
+    }
+
+    return _layers[_depths[getSlot(handle)]];
+}
+
+
+LayerStore::Handle LayerStore::find(const Poco::UUID& id) const
+{
+    std::map<Poco::UUID, Handle>::const_iterator iter = _ids.find(id);
+    return iter != _ids.end() ? iter->second : INVALID_HANDLE;
+}
+
+
+LayerStore::Handle LayerStore::getHandle(std::size_t depth) const
+{
+    return _handles[depth];
+}
+
+
+std::size_t LayerStore::getDepth(Handle handle) const
+{
+    return _depths[getSlot(handle)];
+}
+
+
+std::size_t LayerStore::getSlot(Handle handle)
+{
+    return std::size_t(handle & 0xFFFFFFFF);
+}
+
+
+void LayerStore::moveUp(Handle handle)
+{
+    if (isValid(handle))
+    {
+        std::size_t depth = getDepth(handle);
+
+        if (depth + 1 < _layers.size())
+        {
+            move(depth, depth + 1);
+        }
+    }
+}
+
+
+void LayerStore::moveDown(Handle handle)
+{
+    if (isValid(handle))
+    {
+        std::size_t depth = getDepth(handle);
+
+        if (depth > 0)
+        {
+            move(depth, depth - 1);
+        }
+    }
+}
+
+
+void LayerStore::moveToTop(Handle handle)
+{
+    if (isValid(handle))
+    {
+        move(getDepth(handle), _layers.size() - 1);
+    }
+}
+
+
+void LayerStore::moveToBottom(Handle handle)
+{
+    if (isValid(handle))
+    {
+        move(getDepth(handle), 0);
+    }
+}
+
+
+std::size_t LayerStore::size() const
+{
+    return _layers.size();
+}
+
+
+bool LayerStore::empty() const
+{
+    return _layers.empty();
+}
+
+
+LayerStore::const_iterator LayerStore::begin() const
+{
+    return _layers.begin();
+}
+
+
+LayerStore::const_iterator LayerStore::end() const
+{
+    return _layers.end();
+}
+
+
+const Layer::SharedPtr& LayerStore::operator [] (std::size_t depth) const
+{
+    return _layers[depth];
+}
+
+
+void LayerStore::move(std::size_t from, std::size_t to)
+{
+    if (from == to)
+    {
+        return;
+    }
+
+    std::size_t first = std::min(from, to);
+    std::size_t last = std::max(from, to);
+
+    // Rotate the range so that the layer lands at its new depth.
+    if (from < to)
+    {
+        std::rotate(_layers.begin() + first, _layers.begin() + first + 1, _layers.begin() + last + 1);
+        std::rotate(_handles.begin() + first, _handles.begin() + first + 1, _handles.begin() + last + 1);
+    }
+    else
+    {
+        std::rotate(_layers.begin() + first, _layers.begin() + last, _layers.begin() + last + 1);
+        std::rotate(_handles.begin() + first, _handles.begin() + last, _handles.begin() + last + 1);
+    }
+
+    for (std::size_t depth = first; depth <= last; ++depth)
+    {
+        _depths[getSlot(_handles[depth])] = depth;
+    }
+}
+
+
+} // namespace Kibio
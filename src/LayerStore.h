@@ -0,0 +1,165 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <map>
+#include <vector>
+#include "Poco/UUID.h"
+#include "Layer.h"
+
+
+namespace Kibio {
+
+
+/// \brief The layers of a project, in stacking order.
+///
+/// Layers are kept densely in stacking order, bottom first, so drawing and
+/// updating walk contiguous memory. Each layer is also addressed by a stable
+/// handle that survives reordering and becomes invalid when the layer is
+/// removed. Reordering updates small integer tables instead of scanning and
+/// comparing layer ids, and layers are found by id in O(log n).
+class LayerStore
+{
+public:
+    /// \brief A stable layer handle, a slot and its generation.
+    typedef uint64_t Handle;
+
+    /// \brief An iterator over the layers, bottom first.
+    typedef std::vector<Layer::SharedPtr>::const_iterator const_iterator;
+
+    /// \brief The handle of no layer.
+    static const Handle INVALID_HANDLE;
+
+    /// \brief Create an empty LayerStore.
+    LayerStore();
+
+    /// \brief Add a layer on top of all layers.
+    /// \param layer The layer to add.
+    /// \returns the handle of the layer.
+    Handle add(const Layer::SharedPtr& layer);
+
+    /// \brief Remove a layer.
+    /// \param handle The handle of the layer to remove.
+    void remove(Handle handle);
+
+    /// \brief Remove all layers.
+    void clear();
+
+    /// \returns true if the handle refers to a layer in the store.
+    bool isValid(Handle handle) const;
+
+    /// \brief Get a layer by handle.
+    /// \param handle The handle of the layer.
+    /// \returns the layer or nullptr if the handle is invalid.
+    const Layer::SharedPtr& get(Handle handle) const;
+
+    /// \brief Find a layer by id.
+    /// \param id The layer id.
+    /// \returns the handle of the layer or INVALID_HANDLE.
+    Handle find(const Poco::UUID& id) const;
+
+    /// \brief Get the handle of the layer at a depth.
+    /// \param depth The position in the stack, 0 is the bottom.
+    /// \returns the handle of the layer.
+    Handle getHandle(std::size_t depth) const;
+
+    /// \brief Get the depth of a layer.
+    /// \param handle A valid layer handle.
+    /// \returns the position in the stack, 0 is the bottom.
+    std::size_t getDepth(Handle handle) const;
+
+    /// \brief Get the slot of a handle.
+    ///
+    /// Slots are small dense integers for indexing per-layer data and are
+    /// reused once a layer is removed.
+    ///
+    /// \param handle The handle.
+    /// \returns the slot.
+    static std::size_t getSlot(Handle handle);
+
+    /// \brief Move a layer one position up the stack.
+    /// \param handle The handle of the layer to move.
+    void moveUp(Handle handle);
+
+    /// \brief Move a layer one position down the stack.
+    /// \param handle The handle of the layer to move.
+    void moveDown(Handle handle);
+
+    /// \brief Move a layer to the top of the stack.
+    /// \param handle The handle of the layer to move.
+    void moveToTop(Handle handle);
+
+    /// \brief Move a layer to the bottom of the stack.
+    /// \param handle The handle of the layer to move.
+    void moveToBottom(Handle handle);
+
+    /// \returns the number of layers.
+    std::size_t size() const;
+
+    /// \returns true if there are no layers.
+    bool empty() const;
+
+    /// \returns an iterator to the bottom layer.
+    const_iterator begin() const;
+
+    /// \returns an iterator past the top layer.
+    const_iterator end() const;
+
+    /// \brief Get the layer at a depth.
+    /// \param depth The position in the stack, 0 is the bottom.
+    /// \returns the layer.
+    const Layer::SharedPtr& operator [] (std::size_t depth) const;
+
+private:
+    /// \brief Move a layer between two depths, shifting the layers between.
+    /// \param from The current depth of the layer.
+    /// \param to The new depth of the layer.
+    void move(std::size_t from, std::size_t to);
+
+    /// \brief The layers in stacking order.
+    std::vector<Layer::SharedPtr> _layers;
+
+    /// \brief The handle of each layer in stacking order.
+    std::vector<Handle> _handles;
+
+    /// \brief The current generation of each slot.
+    std::vector<uint32_t> _generations;
+
+    /// \brief The depth of the layer in each slot.
+    std::vector<std::size_t> _depths;
+
+    /// \brief The slots free for reuse.
+    std::vector<std::size_t> _freeSlots;
+
+    /// \brief The handle of each layer by id.
+    std::map<Poco::UUID, Handle> _ids;
+
+};
+
+
+} // namespace Kibio
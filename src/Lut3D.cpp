@@ -0,0 +1,211 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "Lut3D.h"
+#include <fstream>
+#include <sstream>
+#include "ofLog.h"
+#include "ofUtils.h"
+
+
+namespace Kibio {
+
+
+Lut3D::Lut3D():
+    _textureId(0),
+    _size(0)
+{
+}
+
+
+Lut3D::~Lut3D()
+{
+    if (_textureId != 0)
+    {
+        glDeleteTextures(1, &_textureId);
+    }
+}
+
+
+bool Lut3D::load(const std::string& path)
+{
+    std::ifstream file(ofToDataPath(path, true).c_str());
+
+    if (!file)
+    {
+        ofLogError("Lut3D::load") << "Unable to open: " << path;
+        return false;
+    }
+
+    int size = 0;
+    ofVec3f domainMin(0, 0, 0);
+    ofVec3f domainMax(1, 1, 1);
+    std::vector<float> table;
+
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+
+        if (!(tokens >> keyword) || '#' == keyword[0] || "TITLE" == keyword)
+        {
+            continue;
+        }
+        else if ("LUT_3D_SIZE" == keyword)
+        {
+            tokens >> size;
+
+            if (size < 2 || size > MAX_SIZE)
+            {
+                ofLogError("Lut3D::load") << "Invalid table size " << size << ": " << path;
+                return false;
+            }
+
+            table.reserve(size * size * size * 3);
+        }
+        else if ("DOMAIN_MIN" == keyword)
+        {
+            tokens >> domainMin.x >> domainMin.y >> domainMin.z;
+        }
+        else if ("DOMAIN_MAX" == keyword)
+        {
+            tokens >> domainMax.x >> domainMax.y >> domainMax.z;
+        }
+        else if ("LUT_1D_SIZE" == keyword)
+        {
+            ofLogError("Lut3D::load") << "1D tables are not supported: " << path;
+            return false;
+        }
+        else
+        {
+            // A table row, red changes fastest, then green, then blue. This
+            // is the texel order of a 3D texture.
+            std::istringstream row(line);
+            float r, g, b;
+
+            if (!(row >> r >> g >> b))
+            {
+                ofLogWarning("Lut3D::load") << "Skipping unknown line: " << line;
+                continue;
+            }
+
+            table.push_back(r);
+            table.push_back(g);
+            table.push_back(b);
+        }
+    }
+
+    if (0 == size || table.size() != std::size_t(size * size * size * 3))
+    {
+        ofLogError("Lut3D::load") << "Expected " << size * size * size << " entries, found " << table.size() / 3 << ": " << path;
+        return false;
+    }
+
+    if (domainMax.x <= domainMin.x || domainMax.y <= domainMin.y || domainMax.z <= domainMin.z)
+    {
+        ofLogError("Lut3D::load") << "Invalid domain: " << path;
+        return false;
+    }
+
+    if (0 == _textureId)
+    {
+        glGenTextures(1, &_textureId);
+    }
+
+    glBindTexture(GL_TEXTURE_3D, _textureId);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Half floats keep the precision of typical tables and filter everywhere.
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, &table[0]);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    _size = size;
+
+    // Map the domain to [0, 1], then onto the centres of the edge texels.
+    float texelScale = float(size - 1) / size;
+    float texelOffset = 0.5f / size;
+
+    _scale.x = texelScale / (domainMax.x - domainMin.x);
+    _scale.y = texelScale / (domainMax.y - domainMin.y);
+    _scale.z = texelScale / (domainMax.z - domainMin.z);
+
+    _offset.x = texelOffset - domainMin.x * _scale.x;
+    _offset.y = texelOffset - domainMin.y * _scale.y;
+    _offset.z = texelOffset - domainMin.z * _scale.z;
+
+    ofLogVerbose("Lut3D::load") << "Loaded " << size << "^3 table: " << path;
+
+    return true;
+}
+
+
+bool Lut3D::isLoaded() const
+{
+    return _size > 0;
+}
+
+
+int Lut3D::getSize() const
+{
+    return _size;
+}
+
+
+const ofVec3f& Lut3D::getScale() const
+{
+    return _scale;
+}
+
+
+const ofVec3f& Lut3D::getOffset() const
+{
+    return _offset;
+}
+
+
+void Lut3D::bind(int textureUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_3D, _textureId);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+
+void Lut3D::unbind(int textureUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+
+} // namespace Kibio
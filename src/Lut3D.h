@@ -0,0 +1,101 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofGLUtils.h"
+#include "ofVec3f.h"
+
+
+namespace Kibio {
+
+
+/// \brief A 3D colour lookup table.
+///
+/// Tables are loaded from Adobe / Resolve .cube files and kept in a linearly
+/// filtered 3D texture, so the shader applies them with a single lookup.
+class Lut3D
+{
+public:
+    /// \brief Create an empty Lut3D.
+    Lut3D();
+
+    /// \brief Destroy the Lut3D, deleting its texture.
+    ~Lut3D();
+
+    /// \brief Load a .cube file and upload it.
+    /// \param path The path to the .cube file.
+    /// \returns true if loaded successfully.
+    bool load(const std::string& path);
+
+    /// \returns true if a table is loaded.
+    bool isLoaded() const;
+
+    /// \returns the number of entries along each axis.
+    int getSize() const;
+
+    /// \brief Get the scale mapping a colour to texture coordinates.
+    ///
+    /// Maps the input domain onto the texel centres of the first and last
+    /// entries, so the table is sampled exactly at its grid points.
+    ///
+    /// \returns the scale per channel.
+    const ofVec3f& getScale() const;
+
+    /// \returns the offset added after getScale().
+    const ofVec3f& getOffset() const;
+
+    /// \brief Bind the table.
+    /// \param textureUnit The texture unit to bind to.
+    void bind(int textureUnit) const;
+
+    /// \brief Unbind the table.
+    /// \param textureUnit The texture unit it was bound to.
+    void unbind(int textureUnit) const;
+
+    enum
+    {
+        /// \brief The largest supported table size.
+        MAX_SIZE = 256
+    };
+
+private:
+    Lut3D(const Lut3D&);
+    Lut3D& operator = (const Lut3D&);
+
+    /// \brief The texture id, 0 if not loaded.
+    GLuint _textureId;
+
+    int _size;
+
+    ofVec3f _scale;
+    ofVec3f _offset;
+
+};
+
+
+} // namespace Kibio
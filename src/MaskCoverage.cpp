@@ -0,0 +1,183 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "MaskCoverage.h"
+#include <algorithm>
+
+
+namespace Kibio {
+
+
+MaskCoverage::MaskCoverage():
+    _drawnFraction(1),
+    _isValid(false)
+{
+    std::fill(_tiles, _tiles + GRID_SIZE * GRID_SIZE, COVERAGE_PARTIAL);
+
+    _partialMesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    _partialMesh.setUsage(GL_STATIC_DRAW);
+    _fullMesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    _fullMesh.setUsage(GL_STATIC_DRAW);
+}
+
+
+void MaskCoverage::update(const ofPixels& mask)
+{
+    clear();
+
+    std::size_t width = mask.getWidth();
+    std::size_t height = mask.getHeight();
+    std::size_t channels = mask.getNumChannels();
+    const unsigned char* data = mask.getData();
+
+    if (width < GRID_SIZE || height < GRID_SIZE || 0 == channels)
+    {
+        return;
+    }
+
+    std::size_t drawnTiles = 0;
+
+    for (std::size_t row = 0; row < GRID_SIZE; ++row)
+    {
+        // Tile edges fall on whole pixels.
+        std::size_t y0 = row * height / GRID_SIZE;
+        std::size_t y1 = (row + 1) * height / GRID_SIZE;
+
+        for (std::size_t column = 0; column < GRID_SIZE; ++column)
+        {
+            std::size_t x0 = column * width / GRID_SIZE;
+            std::size_t x1 = (column + 1) * width / GRID_SIZE;
+
+            bool isEmpty = true;
+            bool isFull = true;
+
+            for (std::size_t y = (y0 > 0 ? y0 - 1 : 0); y < std::min(y1 + 1, height) && (isEmpty || isFull); ++y)
+            {
+                const unsigned char* pixel = data + (y * width + (x0 > 0 ? x0 - 1 : 0)) * channels;
+                const unsigned char* end = data + (y * width + std::min(x1 + 1, width)) * channels;
+
+                for (; pixel < end; pixel += channels)
+                {
+                    isEmpty = isEmpty && (*pixel == 0);
+                    isFull = isFull && (*pixel == 255);
+                }
+            }
+
+            Coverage coverage = isEmpty ? COVERAGE_EMPTY : (isFull ? COVERAGE_FULL : COVERAGE_PARTIAL);
+
+            _tiles[row * GRID_SIZE + column] = coverage;
+
+            ofRectangle tile(x0, y0, x1 - x0, y1 - y0);
+
+            if (COVERAGE_PARTIAL == coverage)
+            {
+                addTile(_partialMesh, tile);
+                ++drawnTiles;
+            }
+            else if (COVERAGE_FULL == coverage)
+            {
+                addTile(_fullMesh, tile);
+                ++drawnTiles;
+            }
+        }
+    }
+
+    _drawnFraction = float(drawnTiles) / (GRID_SIZE * GRID_SIZE);
+    _isValid = true;
+}
+
+
+void MaskCoverage::clear()
+{
+    std::fill(_tiles, _tiles + GRID_SIZE * GRID_SIZE, COVERAGE_PARTIAL);
+    _partialMesh.clear();
+    _fullMesh.clear();
+    _drawnFraction = 1;
+    _isValid = false;
+}
+
+
+bool MaskCoverage::isValid() const
+{
+    return _isValid;
+}
+
+
+MaskCoverage::Coverage MaskCoverage::getCoverage(std::size_t column, std::size_t row) const
+{
+    return _tiles[row * GRID_SIZE + column];
+}
+
+
+bool MaskCoverage::hasFullTiles() const
+{
+    return _isValid && _fullMesh.getNumVertices() > 0;
+}
+
+
+float MaskCoverage::getDrawnFraction() const
+{
+    return _drawnFraction;
+}
+
+
+void MaskCoverage::drawPartial() const
+{
+    if (_partialMesh.getNumVertices() > 0)
+    {
+        _partialMesh.draw();
+    }
+}
+
+
+void MaskCoverage::drawFull() const
+{
+    if (_fullMesh.getNumVertices() > 0)
+    {
+        _fullMesh.draw();
+    }
+}
+
+
+void MaskCoverage::addTile(ofVboMesh& mesh, const ofRectangle& tile)
+{
+    ofIndexType topLeft = mesh.getNumVertices();
+
+    mesh.addVertex(tile.getTopLeft());
+    mesh.addTexCoord(tile.getTopLeft());
+    mesh.addVertex(tile.getTopRight());
+    mesh.addTexCoord(tile.getTopRight());
+    mesh.addVertex(tile.getBottomRight());
+    mesh.addTexCoord(tile.getBottomRight());
+    mesh.addVertex(tile.getBottomLeft());
+    mesh.addTexCoord(tile.getBottomLeft());
+
+    mesh.addTriangle(topLeft, topLeft + 1, topLeft + 3);
+    mesh.addTriangle(topLeft + 1, topLeft + 2, topLeft + 3);
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,121 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofPixels.h"
+#include "ofVboMesh.h"
+
+
+namespace Kibio {
+
+
+/// \brief A coarse grid of how much of a mask is covered.
+///
+/// The mask is split into GRID_SIZE x GRID_SIZE tiles, each either empty,
+/// partly or fully covered. Empty tiles need not be drawn at all, and fully
+/// covered tiles are opaque, so they can be drawn first and hide whatever
+/// lies below them. Each kind of drawn tile is kept in its own static VBO,
+/// in layer space with texture coordinates in pixels, like WarpMesh.
+///
+/// Tiles are classified with a one pixel border, so that filtering at their
+/// edges never samples the neighbouring tiles.
+class MaskCoverage
+{
+public:
+    /// \brief The tile coverage.
+    enum Coverage
+    {
+        /// \brief Every mask pixel is 0.
+        COVERAGE_EMPTY,
+        /// \brief Some mask pixels are neither 0 nor 255.
+        COVERAGE_PARTIAL,
+        /// \brief Every mask pixel is 255.
+        COVERAGE_FULL
+    };
+
+    /// \brief Create an invalid MaskCoverage.
+    MaskCoverage();
+
+    /// \brief Analyse a mask and rebuild the tile meshes.
+    /// \param mask The mask, only the first channel is used.
+    void update(const ofPixels& mask);
+
+    /// \brief Forget the coverage, for masks that change every frame.
+    void clear();
+
+    /// \returns true if the coverage was analysed.
+    bool isValid() const;
+
+    /// \brief Get the coverage of a tile.
+    /// \param column The tile column.
+    /// \param row The tile row.
+    /// \returns the coverage of the tile.
+    Coverage getCoverage(std::size_t column, std::size_t row) const;
+
+    /// \returns true if any tile is fully covered.
+    bool hasFullTiles() const;
+
+    /// \returns the fraction of the mask area that is drawn.
+    float getDrawnFraction() const;
+
+    /// \brief Draw the partly covered tiles.
+    void drawPartial() const;
+
+    /// \brief Draw the fully covered tiles.
+    void drawFull() const;
+
+    enum
+    {
+        /// \brief The number of tiles along each side.
+        GRID_SIZE = 16
+    };
+
+private:
+    /// \brief Add a tile to a mesh.
+    /// \param mesh The mesh to add to.
+    /// \param tile The tile in pixels.
+    static void addTile(ofVboMesh& mesh, const ofRectangle& tile);
+
+    /// \brief The tile coverage, row by row.
+    Coverage _tiles[GRID_SIZE * GRID_SIZE];
+
+    /// \brief The partly covered tiles.
+    ofVboMesh _partialMesh;
+
+    /// \brief The fully covered tiles.
+    ofVboMesh _fullMesh;
+
+    /// \brief The fraction of the mask area that is drawn.
+    float _drawnFraction;
+
+    bool _isValid;
+
+};
+
+
+} // namespace Kibio
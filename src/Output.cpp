@@ -0,0 +1,270 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "Output.h"
+#include "ofAppRunner.h"
+#include "ofGraphics.h"
+#include "ofLog.h"
+#include "ofMath.h"
+#include "ResourceRegistry.h"
+
+
+namespace Kibio {
+
+
+Output::Blend::Blend():
+    left(0),
+    right(0),
+    top(0),
+    bottom(0),
+    gamma(2.2),
+    curve(2),
+    luminance(0.5)
+{
+}
+
+
+Output::Output():
+    _isPlaced(false),
+    _isEditing(false)
+{
+    _warper.hide();
+}
+
+
+void Output::setCrop(const ofRectangle& crop)
+{
+    _crop = crop;
+}
+
+
+const ofRectangle& Output::getCrop() const
+{
+    return _crop;
+}
+
+
+void Output::setBlend(const Blend& blend)
+{
+    _blend = blend;
+}
+
+
+const Output::Blend& Output::getBlend() const
+{
+    return _blend;
+}
+
+
+void Output::setEditing(bool editing)
+{
+    _isEditing = editing;
+
+    if (_isEditing)
+    {
+        _warper.enableMouseControls();
+        _warper.show();
+    }
+    else
+    {
+        _warper.disableMouseControls();
+        _warper.hide();
+    }
+}
+
+
+bool Output::isEditing() const
+{
+    return _isEditing;
+}
+
+
+void Output::draw(const ofTexture& canvas)
+{
+    if (!canvas.isAllocated())
+    {
+        return;
+    }
+
+    ofRectangle source = _crop;
+
+    if (source.isEmpty())
+    {
+        source.set(0, 0, canvas.getWidth(), canvas.getHeight());
+    }
+
+    _warper.setSourceRect(ofRectangle(0, 0, source.getWidth(), source.getHeight()));
+
+    if (!_isPlaced)
+    {
+        _warper.setTargetRect(ofRectangle(0, 0, ofGetWidth(), ofGetHeight()));
+        _isPlaced = true;
+    }
+
+    _warpMesh.update(source);
+
+    // The canvas is already composited over black.
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    ofSetColor(255);
+    ofPushMatrix();
+    ofMultMatrix(_warper.getMatrix());
+
+    if (!_shader)
+    {
+        _shader = ResourceRegistry::getDefault().getShader("shaders/GL3/output");
+    }
+
+    _shader->begin();
+    _shader->setUniformTexture("tex0", canvas, 0);
+    _shader->setUniform4f("crop", source.getX(), source.getY(), source.getWidth(), source.getHeight());
+    _shader->setUniform4f("blendWidth", _blend.left, _blend.right, _blend.top, _blend.bottom);
+    _shader->setUniform1f("blendGamma", _blend.gamma);
+    _shader->setUniform1f("blendCurve", _blend.curve);
+    _shader->setUniform1f("blendLuminance", _blend.luminance);
+    _warpMesh.draw();
+    _shader->end();
+
+    ofPopMatrix();
+
+    if (_isEditing)
+    {
+        ofEnableAlphaBlending();
+        ofSetColor(255, 255, 0);
+        _warper.drawQuadOutline();
+
+        const ofPoint* corners = _warper.getTargetPoints();
+
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            ofDrawCircle(corners[i], 6);
+        }
+    }
+
+    ofPopStyle();
+}
+
+
+WarpMesh& Output::getWarpMesh()
+{
+    return _warpMesh;
+}
+
+
+Json::Value Output::toJSON(const Output& object)
+{
+    Json::Value json;
+
+    json["crop"]["x"] = object._crop.getX();
+    json["crop"]["y"] = object._crop.getY();
+    json["crop"]["width"] = object._crop.getWidth();
+    json["crop"]["height"] = object._crop.getHeight();
+
+    if (object._isPlaced)
+    {
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            Json::Value point;
+            point["x"] = object._warper.dstPoints[i].x;
+            point["y"] = object._warper.dstPoints[i].y;
+            json["quad"].append(point);
+        }
+    }
+
+    json["warp"] = WarpMesh::toJSON(object._warpMesh);
+
+    json["blend"]["left"] = object._blend.left;
+    json["blend"]["right"] = object._blend.right;
+    json["blend"]["top"] = object._blend.top;
+    json["blend"]["bottom"] = object._blend.bottom;
+    json["blend"]["gamma"] = object._blend.gamma;
+    json["blend"]["curve"] = object._blend.curve;
+    json["blend"]["luminance"] = object._blend.luminance;
+
+    return json;
+}
+
+
+bool Output::fromJSON(const Json::Value& json, Output& object)
+{
+    if (json.isMember("crop"))
+    {
+        const Json::Value& crop = json["crop"];
+
+        object.setCrop(ofRectangle(crop.get("x", 0).asFloat(),
+                                   crop.get("y", 0).asFloat(),
+                                   crop.get("width", 0).asFloat(),
+                                   crop.get("height", 0).asFloat()));
+    }
+
+    if (json.isMember("quad"))
+    {
+        const Json::Value& quad = json["quad"];
+
+        if (4 == quad.size())
+        {
+            std::vector<ofPoint> points;
+
+            for (Json::ArrayIndex i = 0; i < quad.size(); ++i)
+            {
+                points.push_back(ofPoint(quad[i].get("x", 0).asFloat(),
+                                         quad[i].get("y", 0).asFloat()));
+            }
+
+            object._warper.setTargetPoints(points);
+            object._isPlaced = true;
+        }
+        else
+        {
+            ofLogWarning("Output::fromJSON") << "Invalid output quad size: " << quad.size();
+        }
+    }
+
+    if (json.isMember("warp") && !WarpMesh::fromJSON(json["warp"], object._warpMesh))
+    {
+        ofLogWarning("Output::fromJSON") << "Invalid output warp, using a flat lattice.";
+    }
+
+    if (json.isMember("blend"))
+    {
+        const Json::Value& blend = json["blend"];
+
+        Blend settings;
+        settings.left = blend.get("left", settings.left).asFloat();
+        settings.right = blend.get("right", settings.right).asFloat();
+        settings.top = blend.get("top", settings.top).asFloat();
+        settings.bottom = blend.get("bottom", settings.bottom).asFloat();
+        settings.gamma = std::max(0.1f, blend.get("gamma", settings.gamma).asFloat());
+        settings.curve = std::max(0.1f, blend.get("curve", settings.curve).asFloat());
+        settings.luminance = ofClamp(blend.get("luminance", settings.luminance).asFloat(), 0, 1);
+        object.setBlend(settings);
+    }
+
+    return true;
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,141 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <json/json.h>
+#include "ofShader.h"
+#include "ofTexture.h"
+#include "ofxQuadWarp.h"
+#include "WarpMesh.h"
+
+
+namespace Kibio {
+
+
+/// \brief Presents the composited canvas on a projector.
+///
+/// An output crops a region of the canvas and warps it onto its window with
+/// a keystone quad and an optional Bézier mesh. This corrects the alignment
+/// of a whole projector in one textured pass, however many layers there are,
+/// while layers are still edited in the undistorted canvas.
+///
+/// Overlapping projectors are soft edge blended in the same pass. The blend
+/// ramps are computed in the output shader from the blend zone settings, so
+/// blending needs no mask layers or textures.
+class Output
+{
+public:
+    /// \brief Soft edge blend settings.
+    struct Blend
+    {
+        Blend();
+
+        /// \brief The blend zone widths at each edge of the crop in canvas
+        ///     pixels, 0 for no blending.
+        float left;
+        float right;
+        float top;
+        float bottom;
+
+        /// \brief The projector gamma the ramps are corrected for.
+        float gamma;
+
+        /// \brief The steepness of the ramps, 1 is linear.
+        float curve;
+
+        /// \brief The ramp value at the middle of a blend zone.
+        float luminance;
+    };
+
+    /// \brief Create an Output that shows the whole canvas.
+    Output();
+
+    /// \brief Set the region of the canvas to present.
+    /// \param crop The region in canvas pixels, or an empty rectangle for the
+    ///     whole canvas.
+    void setCrop(const ofRectangle& crop);
+
+    /// \returns the region of the canvas to present, empty for all of it.
+    const ofRectangle& getCrop() const;
+
+    /// \brief Set the soft edge blend.
+    /// \param blend The blend settings.
+    void setBlend(const Blend& blend);
+
+    /// \returns the soft edge blend.
+    const Blend& getBlend() const;
+
+    /// \brief Show the keystone handles and let the mouse move them.
+    /// \param editing true to edit the output warp.
+    void setEditing(bool editing);
+
+    /// \returns true if the output warp is being edited.
+    bool isEditing() const;
+
+    /// \brief Present the canvas.
+    /// \param canvas The composited canvas.
+    void draw(const ofTexture& canvas);
+
+    /// \returns the output warp mesh.
+    WarpMesh& getWarpMesh();
+
+    /// \brief Save the object to JSON.
+    /// \brief The object to save.
+    /// \returns the object as JSON.
+    static Json::Value toJSON(const Output& object);
+
+    /// \brief Load the object from JSON.
+    /// \brief json The object as JSON.
+    /// \brief object The object to load from JSON.
+    /// \returns true iff deserialized successfully.
+    static bool fromJSON(const Json::Value& json, Output& object);
+
+private:
+    /// \brief The canvas region to present, empty for the whole canvas.
+    ofRectangle _crop;
+
+    /// \brief The keystone quad, from the crop size to window pixels.
+    ofxQuadWarp _warper;
+
+    /// \brief The output mesh, drawn under the keystone.
+    WarpMesh _warpMesh;
+
+    Blend _blend;
+
+    /// \brief The output shader, shared by all outputs.
+    std::shared_ptr<ofShader> _shader;
+
+    /// \brief true once the keystone quad was placed.
+    bool _isPlaced;
+
+    bool _isEditing;
+
+};
+
+
+} // namespace Kibio
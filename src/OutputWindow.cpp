@@ -0,0 +1,104 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "OutputWindow.h"
+#include "ofAppGLFWWindow.h"
+#include "ofAppRunner.h"
+#include "ofGraphics.h"
+
+
+namespace Kibio {
+
+
+OutputWindow::OutputWindow(const ofFbo& canvas, const Json::Value& json):
+    _canvas(canvas),
+    _monitor(0)
+{
+    const Json::Value& window = json["window"];
+
+    ofGLFWWindowSettings settings;
+    settings.setGLVersion(3, 3);
+    settings.width = window.get("width", 1024).asInt();
+    settings.height = window.get("height", 768).asInt();
+    settings.setPosition(ofVec2f(window.get("x", 0).asInt(),
+                                 window.get("y", 0).asInt()));
+    settings.monitor = window.get("monitor", 0).asInt();
+    _monitor = settings.monitor;
+    settings.windowMode = window.get("fullscreen", false).asBool() ? OF_FULLSCREEN : OF_WINDOW;
+    settings.decorated = !window.get("fullscreen", false).asBool();
+    settings.shareContextWith = ofGetMainWindow();
+
+    _window = ofCreateWindow(settings);
+
+    // Only the main window waits for the vertical sync, or every window
+    // would divide the frame rate.
+    _window->setVerticalSync(false);
+    _window->setWindowTitle("Kibio Output");
+
+    Output::fromJSON(json, _output);
+
+    ofAddListener(_window->events().draw, this, &OutputWindow::onDraw);
+}
+
+
+OutputWindow::~OutputWindow()
+{
+    ofRemoveListener(_window->events().draw, this, &OutputWindow::onDraw);
+    _window->setWindowShouldClose();
+}
+
+
+Output& OutputWindow::getOutput()
+{
+    return _output;
+}
+
+
+Json::Value OutputWindow::toJSON(const OutputWindow& object)
+{
+    Json::Value json = Output::toJSON(object._output);
+
+    ofPoint position = object._window->getWindowPosition();
+
+    json["window"]["x"] = position.x;
+    json["window"]["y"] = position.y;
+    json["window"]["width"] = object._window->getWidth();
+    json["window"]["height"] = object._window->getHeight();
+    json["window"]["monitor"] = object._monitor;
+    json["window"]["fullscreen"] = (object._window->getWindowMode() == OF_FULLSCREEN);
+
+    return json;
+}
+
+
+void OutputWindow::onDraw(ofEventArgs& args)
+{
+    ofBackground(0);
+    _output.draw(_canvas.getTexture());
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,87 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <json/json.h>
+#include "ofAppBaseWindow.h"
+#include "ofEvents.h"
+#include "ofFbo.h"
+#include "Output.h"
+
+
+namespace Kibio {
+
+
+/// \brief An additional window that presents the canvas through an Output.
+///
+/// The window shares the GL context of the main window, so it draws the
+/// canvas texture that the main window composited this frame. Videos are
+/// decoded and layers are composited once, however many windows there are.
+class OutputWindow
+{
+public:
+    /// \brief A typedef for a shared output window.
+    typedef std::shared_ptr<OutputWindow> SharedPtr;
+
+    /// \brief Open an output window.
+    /// \param canvas The canvas to present, owned by the app.
+    /// \param json The window and output settings.
+    OutputWindow(const ofFbo& canvas, const Json::Value& json);
+
+    /// \brief Stop drawing into the window.
+    ~OutputWindow();
+
+    /// \returns the output of the window.
+    Output& getOutput();
+
+    /// \brief Save the object to JSON.
+    /// \brief The object to save.
+    /// \returns the object as JSON.
+    static Json::Value toJSON(const OutputWindow& object);
+
+    /// \brief Draw the window.
+    /// \param args The event arguments.
+    void onDraw(ofEventArgs& args);
+
+private:
+    /// \brief The canvas to present.
+    const ofFbo& _canvas;
+
+    /// \brief The output.
+    Output _output;
+
+    /// \brief The window.
+    std::shared_ptr<ofAppBaseWindow> _window;
+
+    /// \brief The monitor the window was created on.
+    int _monitor;
+
+};
+
+
+} // namespace Kibio
@@ -0,0 +1,77 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "PresentationClock.h"
+#include "ofUtils.h"
+
+
+namespace Kibio {
+
+
+PresentationClock::PresentationClock():
+    _startMicros(ofGetElapsedTimeMicros()),
+    _time(0),
+    _isHeld(false)
+{
+}
+
+
+void PresentationClock::update()
+{
+    if (!_isHeld)
+    {
+        _time = (ofGetElapsedTimeMicros() - _startMicros) / 1000000.0;
+    }
+}
+
+
+double PresentationClock::getTime() const
+{
+    return _time;
+}
+
+
+void PresentationClock::restart()
+{
+    _startMicros = ofGetElapsedTimeMicros();
+    _time = 0;
+    _isHeld = false;
+}
+
+
+void PresentationClock::hold()
+{
+    _isHeld = true;
+}
+
+
+bool PresentationClock::isHeld() const
+{
+    return _isHeld;
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,78 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <cstdint>
+
+
+namespace Kibio {
+
+
+/// \brief A project-wide clock that schedules video frames by timestamp.
+///
+/// The clock is sampled once per app frame so that every layer selects its
+/// frame for the same presentation time. Layers drop frames that are already
+/// late and hold the current frame until the next one is due.
+///
+/// While the clock is held, layers keep presenting their current frame. This
+/// is used to preroll a restart so that all layers jump on the same frame.
+class PresentationClock
+{
+public:
+    /// \brief Create a running PresentationClock starting at zero.
+    PresentationClock();
+
+    /// \brief Sample the presentation time for this frame.
+    void update();
+
+    /// \returns the presentation time in seconds for this frame.
+    double getTime() const;
+
+    /// \brief Restart the clock from zero and release it.
+    void restart();
+
+    /// \brief Hold the clock at its current time until restarted.
+    void hold();
+
+    /// \returns true if the clock is held.
+    bool isHeld() const;
+
+private:
+    /// \brief The elapsed app time in microseconds at time zero.
+    uint64_t _startMicros;
+
+    /// \brief The presentation time in seconds for this frame.
+    double _time;
+
+    /// \brief true if the clock is held.
+    bool _isHeld;
+
+};
+
+
+} // namespace Kibio
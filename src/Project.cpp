@@ -25,6 +25,9 @@
 
 
 #include "Project.h"
+#include <algorithm>
+#include "HapDecoder.h"
+#include "VideoDecoder.h"
 #include "Poco/FileStream.h"
 #include "Poco/UTF8String.h"
 
@@ -39,6 +42,13 @@ Project::Project(AbstractApp& parent):
     _parent(parent),
     _isLoaded(false),
     _maskBrushEnabled(false),
+    _showStats(false),
+    _isDamaged(true),
+    _layerIndex(_layers),
+    _isCornerHovered(false),
+    _updateMicros(0),
+    _frameMicros(0),
+    _averageFrameMicros(0),
     _transform(NONE)
 {
     ofRegisterDragEvents(this);
@@ -57,32 +67,156 @@ Project::~Project()
 
 void Project::update()
 {
-    std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.begin();
+    uint64_t start = ofGetElapsedTimeMicros();
 
-    while (iter != _layers.end())
+    _clock.update();
+
+    if (_clock.isHeld())
     {
-        if ((*iter))
+        bool isPrerolled = true;
+
+        std::map<std::string, SharedSource>::iterator source = _sources.begin();
+
+        while (source != _sources.end())
         {
-            (*iter)->update();
+            VideoSource::SharedPtr video = source->second.source.lock();
+
+            if (video && !video->preroll())
+            {
+                isPrerolled = false;
+            }
+
+            ++source;
         }
 
-        ++iter;
+        if (isPrerolled)
+        {
+            _clock.restart();
+        }
+    }
+
+    // Each shared source is updated once, however many layers use it.
+    std::map<std::string, SharedSource>::iterator source = _sources.begin();
+
+    while (source != _sources.end())
+    {
+        VideoSource::SharedPtr video = source->second.source.lock();
+
+        if (!video)
+        {
+            _sources.erase(source++);
+            continue;
+        }
+
+        SharedSource& shared = source->second;
+        double time = std::max(0.0, _clock.getTime() + shared.timeOffset);
+        uint64_t now = ofGetElapsedTimeMillis();
+
+        // The first entry of a source holds the level of its largest layer.
+        std::vector<std::pair<const VideoSource*, int> >::const_iterator visible =
+            std::lower_bound(_visibleSources.begin(),
+                             _visibleSources.end(),
+                             std::make_pair(static_cast<const VideoSource*>(video.get()), -1));
+
+        if (visible != _visibleSources.end() && visible->first == video.get())
+        {
+            shared.lastVisibleMillis = now;
+
+            // Raise the resolution at once, but only lower it once the
+            // layers have stayed small, so resizing does not thrash.
+            if (visible->second <= shared.downscale)
+            {
+                shared.downscaleMillis = now;
+
+                if (visible->second < shared.downscale)
+                {
+                    shared.downscale = visible->second;
+                    video->setDownscale(shared.downscale);
+                }
+            }
+            else if (now - shared.downscaleMillis > DOWNSCALE_DELAY_MILLIS)
+            {
+                shared.downscale = visible->second;
+                shared.downscaleMillis = now;
+                video->setDownscale(shared.downscale);
+            }
+
+            if (shared.isSuspended)
+            {
+                // Start decoding again at the current time, and keep the
+                // last frame until the first new one is ready.
+                video->seek(time);
+                shared.isSuspended = false;
+                shared.isResuming = true;
+            }
+        }
+        else if (!shared.isSuspended && now - shared.lastVisibleMillis > SUSPEND_DELAY_MILLIS)
+        {
+            // Without updates the decoder fills its ring and then idles.
+            ofLogVerbose("Project::update") << "Suspending hidden source: " << source->first;
+            shared.isSuspended = true;
+            shared.isResuming = false;
+        }
+
+        if (shared.isResuming && video->preroll())
+        {
+            shared.isResuming = false;
+        }
+
+        if (!_clock.isHeld() && !shared.isSuspended && !shared.isResuming)
+        {
+            video->update(time);
+        }
+
+        ++source;
     }
+
+    for (std::size_t depth = 0; depth < _layers.size(); ++depth)
+    {
+        const std::shared_ptr<Layer>& layer = _layers[depth];
+
+        layer->update();
+
+        if (layer->isDirty())
+        {
+            // Culled layers change nothing on screen.
+            if (layer->isVisible())
+            {
+                _isDamaged = true;
+            }
+
+            _layerIndex.update(_layers.getHandle(depth));
+        }
+    }
+
+    updateVisibility();
+    updateHover();
+
+    _updateMicros = ofGetElapsedTimeMicros() - start;
 }
 
 
 void Project::draw()
 {
-    std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.begin();
+    uint64_t start = ofGetElapsedTimeMicros();
 
-    while (iter != _layers.end())
+    LayerStore::const_iterator iter = _layers.begin();
+
+    if (_parent.getMode() == AbstractApp::PRESENT)
+    {
+        drawBatched();
+    }
+    else
     {
-        if ((*iter))
+        while (iter != _layers.end())
         {
-            (*iter)->draw();
-        }
+            if ((*iter))
+            {
+                (*iter)->draw();
+            }
 
-        ++iter;
+            ++iter;
+        }
     }
 
     if (_dragging)
@@ -107,6 +241,170 @@ void Project::draw()
 
         ofPopStyle();
     }
+
+    _frameMicros = _updateMicros + ofGetElapsedTimeMicros() - start;
+    _averageFrameMicros = _averageFrameMicros == 0 ? _frameMicros : _averageFrameMicros * 0.95 + _frameMicros * 0.05;
+
+    if (_showStats && _parent.getMode() == AbstractApp::EDIT)
+    {
+        std::stringstream frame;
+        frame << "layers: " << _layers.size() << ", frame: " << std::fixed << std::setprecision(2);
+        frame << _frameMicros / 1000.0 << " ms (avg ";
+        frame << _averageFrameMicros / 1000.0 << " ms)";
+
+        ofDrawBitmapStringHighlight(frame.str(), 14, 20);
+
+        iter = _layers.begin();
+
+        while (iter != _layers.end())
+        {
+            if ((*iter))
+            {
+                TextureUploader::Stats stats = (*iter)->getUploadStats();
+
+                std::stringstream ss;
+                ss << "upload: " << std::fixed << std::setprecision(2);
+                ss << stats.lastMicros / 1000.0 << " ms (avg ";
+                ss << stats.averageMicros / 1000.0 << " ms, ";
+                ss << stats.stalls << " stalls)";
+
+                ofPoint centroid = (*iter)->getCentroid();
+                ofDrawBitmapStringHighlight(ss.str(), centroid.x, centroid.y);
+            }
+
+            ++iter;
+        }
+    }
+}
+
+
+void Project::drawBatched()
+{
+    _drawList.clear();
+
+    std::size_t batchCount = 0;
+    std::size_t order = 0;
+
+    LayerStore::const_iterator iter = _layers.begin();
+
+    while (iter != _layers.end())
+    {
+        Layer* layer = iter->get();
+        ++iter;
+
+        if (!layer || !layer->isVisible())
+        {
+            continue;
+        }
+
+        ofRectangle bounds = layer->getBounds();
+        LayerBatch* batch = nullptr;
+
+        if (layer->isBatchable())
+        {
+            for (std::size_t i = 0; i < batchCount; ++i)
+            {
+                if (_batches[i]->canAdd(*layer, bounds))
+                {
+                    batch = _batches[i].get();
+                    break;
+                }
+            }
+
+            if (!batch)
+            {
+                if (batchCount == _batches.size())
+                {
+                    _batches.push_back(std::make_shared<LayerBatch>());
+                }
+
+                batch = _batches[batchCount++].get();
+                batch->begin(layer->_video, layer->getBlendMode());
+                _drawList.push_back(DrawItem(nullptr, batch, order));
+            }
+
+            batch->add(*layer);
+        }
+        else
+        {
+            _drawList.push_back(DrawItem(layer, nullptr, order));
+        }
+
+        ++order;
+
+        // Layers above this one may no longer be drawn with earlier batches
+        // where they overlap it.
+        for (std::size_t i = 0; i < batchCount; ++i)
+        {
+            if (_batches[i].get() != batch)
+            {
+                _batches[i]->cover(bounds);
+            }
+        }
+    }
+
+    // A batch of one is drawn as a plain layer.
+    for (std::size_t i = 0; i < _drawList.size(); ++i)
+    {
+        if (_drawList[i].batch && _drawList[i].batch->size() == 1)
+        {
+            _drawList[i].layer = _drawList[i].batch->getLayer(0);
+            _drawList[i].batch = nullptr;
+        }
+    }
+
+    // The stencil holds the rank of the top opaque tile at each pixel. The
+    // top layer has the highest rank, and layers below the lowest rank never
+    // draw opaque tiles first.
+    for (std::size_t i = 0; i < _drawList.size(); ++i)
+    {
+        _drawList[i].rank = std::max(0, int(MAX_STENCIL_RANK) - int(order - 1 - _drawList[i].order));
+    }
+
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+
+    // Fully covered mask tiles front to back, so that each pixel is only
+    // filled by the top opaque tile.
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+    for (std::size_t i = _drawList.size(); i > 0; --i)
+    {
+        const DrawItem& item = _drawList[i - 1];
+
+        if (item.layer && item.rank > 0 && item.layer->isOpaqueDrawable())
+        {
+            glStencilFunc(GL_GREATER, item.rank, 0xff);
+            item.layer->drawOpaqueTiles();
+        }
+    }
+
+    // Everything else back to front, rejected early under opaque tiles of
+    // the layers above. Batches only draw over opaque tiles of plain layers
+    // below their first layer, since no layer between overlaps them.
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+    for (std::size_t i = 0; i < _drawList.size(); ++i)
+    {
+        glStencilFunc(GL_GEQUAL, _drawList[i].rank, 0xff);
+
+        if (_drawList[i].layer)
+        {
+            _drawList[i].layer->draw();
+        }
+        else
+        {
+            _drawList[i].batch->draw();
+        }
+    }
+
+    glDisable(GL_STENCIL_TEST);
+
+    for (std::size_t i = 0; i < batchCount; ++i)
+    {
+        _batches[i]->clear();
+    }
 }
 
 
@@ -245,7 +543,8 @@ void Project::newLayerWithVideoAtPoint(const Poco::Path& videoPath, const ofPoin
     }
     else
     {
-        _layers.push_back(layer);
+        _layerIndex.add(_layers.add(layer));
+        _isDamaged = true;
     }
 }
 
@@ -281,14 +580,22 @@ void Project::deleteLayerAtPoint(const ofPoint& point)
 
     if (layer)
     {
-        _layers.erase(std::find(_layers.begin(),
-                                _layers.end(),
-                                layer));
+        LayerStore::Handle handle = _layers.find(layer->getId());
+
+        _layerIndex.remove(handle);
+        _layers.remove(handle);
+
+        _isDamaged = true;
         
         if (_lastSelectedLayer && _lastSelectedLayer->getId() == layer->getId())
         {
             _lastSelectedLayer.reset();
         }
+
+        if (_hoveredLayer == layer)
+        {
+            _hoveredLayer.reset();
+        }
     }
     else
     {
@@ -324,105 +631,42 @@ void Project::shiftLayer(LayerShift shift)
     }
 }
     
-void Project::shiftLayer(Layer::SharedPtr layer, LayerShift shift)
+void Project::shiftLayer(const Layer::SharedPtr& layer, LayerShift shift)
 {
     if (layer)
     {
-        
+        LayerStore::Handle handle = _layers.find(layer->getId());
+
         if (shift == LAYER_SHIFT_UP)
         {
-
-            std::deque<std::shared_ptr<Layer> >::iterator iter = _layers.begin();
-            
-            while (iter != _layers.end() - 1)
-            {
-                if ((*iter) && (*iter)->getId() == layer->getId())
-                {
-                    std::iter_swap(iter, iter + 1);
-                    break;
-                }
-                
-                ++iter;
-            }
+            _layers.moveUp(handle);
         }
         else if (shift == LAYER_SHIFT_DOWN)
         {
-            std::deque<std::shared_ptr<Layer> >::iterator iter = _layers.begin() + 1;
-            
-            while (iter != _layers.end())
-            {
-                if ((*iter) && (*iter)->getId() == layer->getId())
-                {
-                    std::iter_swap(iter, iter - 1);
-                    break;
-                }
-                
-                ++iter;
-            }
+            _layers.moveDown(handle);
         }
-        if (shift == LAYER_SHIFT_TOP)
+        else if (shift == LAYER_SHIFT_TOP)
         {
-            // check if this is already the top layer, if so ignore
-            if (layer->getId() != _layers[_layers.size() - 1]->getId())
-            {
-                std::deque<std::shared_ptr<Layer> >::iterator iter = _layers.begin();
-                
-                while (iter != _layers.end())
-                {
-                    if ((*iter) && (*iter)->getId() == layer->getId())
-                    {
-                        _layers.erase(iter);
-                        _layers.push_back(layer);
-                        break;
-                    }
-                    
-                    ++iter;
-                }
-            }
+            _layers.moveToTop(handle);
         }
         else if (shift == LAYER_SHIFT_BOTTOM)
         {
-            // check if this is already the bottom layer, if so ignore
-            if (layer->getId() != _layers[0]->getId())
-            {
-                std::deque<std::shared_ptr<Layer> >::iterator iter = _layers.begin();
-                
-                while (iter != _layers.end())
-                {
-                    if ((*iter) && (*iter)->getId() == layer->getId())
-                    {
-                        _layers.erase(iter);
-                        _layers.push_front(layer);
-                        break;
-                    }
-                    
-                    ++iter;
-                }
-            }
+            _layers.moveToBottom(handle);
         }
+
+        _isDamaged = true;
     }
 }
 
 std::shared_ptr<Layer> Project::getLayerAtPoint(const ofPoint& point) const
 {
-    std::shared_ptr<Layer> empty;
-
-    std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.end() - 1;
-
-    while (iter != _layers.begin() - 1)
-    {
-        if ((*iter))
-        {
-            if ((*iter)->hitTest(point))
-            {
-                return *iter;
-            }
-        }
+    return _layers.get(_layerIndex.getLayerAtPoint(point));
+}
 
-        --iter;
-    }
 
-    return empty;
+const std::shared_ptr<Layer>& Project::getHoveredLayer() const
+{
+    return _hoveredLayer;
 }
 
 
@@ -534,7 +778,7 @@ bool Project::save()
 
     try
     {
-        std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.begin();
+        LayerStore::const_iterator iter = _layers.begin();
 
         while (iter != _layers.end())
         {
@@ -609,19 +853,238 @@ bool Project::isLoaded() const
 
 bool Project::isCornerHovered(const ofPoint& point) const
 {
-    std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.begin();
+    return _layerIndex.isCornerAtPoint(point);
+}
 
-    while (iter != _layers.end())
+
+bool Project::isCornerHovered() const
+{
+    return _isCornerHovered;
+}
+
+
+void Project::updateHover()
+{
+    if (_parent.getMode() == AbstractApp::EDIT)
+    {
+        ofPoint mouse(ofGetMouseX(), ofGetMouseY());
+
+        _hoveredLayer = getLayerAtPoint(mouse);
+        _isCornerHovered = isCornerHovered(mouse);
+    }
+    else
     {
-        if ((*iter))
+        _hoveredLayer.reset();
+        _isCornerHovered = false;
+    }
+}
+
+
+void Project::updateVisibility()
+{
+    _visibleSources.clear();
+    _occluders.clear();
+
+    bool isCulling = (_parent.getMode() == AbstractApp::PRESENT);
+
+    ofRectangle canvas = _canvasBounds;
+
+    if (canvas.isEmpty())
+    {
+        canvas.set(0, 0, ofGetWidth(), ofGetHeight());
+    }
+
+    // From the top layer down, so that each layer is tested against the
+    // opaque layers above it.
+    for (std::size_t i = _layers.size(); i > 0; --i)
+    {
+        Layer& layer = *_layers[i - 1];
+        bool isVisible = true;
+
+        if (isCulling)
         {
-            if ((*iter)->getHoveredCorner(point)) return true;
+            ofRectangle bounds = layer.getBounds();
+
+            isVisible = !layer.isHidden() && canvas.intersects(bounds);
+
+            for (std::size_t j = 0; isVisible && j < _occluders.size(); ++j)
+            {
+                if (_occluders[j]->covers(bounds))
+                {
+                    isVisible = false;
+                }
+            }
+
+            if (isVisible && layer.isOpaque())
+            {
+                _occluders.push_back(&layer);
+            }
         }
 
-        ++iter;
+        if (isVisible != layer._isVisible)
+        {
+            layer._isVisible = isVisible;
+            _isDamaged = true;
+        }
+
+        if (isVisible && layer._video)
+        {
+            _visibleSources.push_back(std::make_pair(layer._video.get(), layer.getDownscaleLevel()));
+        }
+    }
+
+    std::sort(_visibleSources.begin(), _visibleSources.end());
+}
+
+
+void Project::setCanvasSize(float width, float height)
+{
+    _canvasBounds.set(0, 0, width, height);
+}
+
+
+void Project::indexLayers()
+{
+    _layerIndex.clear();
+
+    for (std::size_t depth = 0; depth < _layers.size(); ++depth)
+    {
+        _layerIndex.add(_layers.getHandle(depth));
+    }
+}
+
+
+void Project::restart()
+{
+    std::map<std::string, SharedSource>::iterator source = _sources.begin();
+
+    while (source != _sources.end())
+    {
+        VideoSource::SharedPtr video = source->second.source.lock();
+
+        if (video)
+        {
+            video->seek(std::max(0.0, source->second.timeOffset));
+        }
+
+        ++source;
+    }
+
+    _clock.hold();
+}
+
+
+VideoSource::SharedPtr Project::getVideoSource(const std::string& path,
+                                               double timeOffset,
+                                               bool cacheEnabled)
+{
+    std::string key = path + "@" + ofToString(timeOffset) + (cacheEnabled ? "+cache" : "");
+
+    VideoSource::SharedPtr video = _sources[key].source.lock();
+
+    if (!video)
+    {
+        // HAP movies are uploaded as compressed textures without decoding.
+        if (HapDecoder::canLoad(path))
+        {
+            video = std::make_shared<HapDecoder>();
+        }
+        else
+        {
+            VideoDecoder::SharedPtr decoder = std::make_shared<VideoDecoder>();
+            decoder->setCacheEnabled(cacheEnabled);
+            video = decoder;
+        }
+
+        if (!video->load(path))
+        {
+            _sources.erase(key);
+            return nullptr;
+        }
+
+        // Join the timeline where it currently is.
+        video->seek(std::max(0.0, _clock.getTime() + timeOffset));
+
+        // Count the new source as visible until the next visibility update,
+        // so it is neither suspended nor downscaled on its first frame.
+        uint64_t now = ofGetElapsedTimeMillis();
+
+        SharedSource& shared = _sources[key];
+        shared = SharedSource();
+        shared.source = video;
+        shared.timeOffset = timeOffset;
+        shared.lastVisibleMillis = now;
+        shared.downscaleMillis = now;
     }
 
-    return false;
+    return video;
+}
+
+
+void Project::newInstanceOfLayerAtPoint(const ofPoint& point)
+{
+    if (_parent.getMode() != AbstractApp::EDIT)
+    {
+        return;
+    }
+
+    std::shared_ptr<Layer> source = getLayerAtPoint(point);
+
+    if (!source || !source->_video)
+    {
+        ofLogError("Project::newInstanceOfLayerAtPoint") << "No layer at point: " << point;
+        return;
+    }
+
+    std::shared_ptr<Layer> layer(new Layer(*this));
+
+    layer->setInstanceOf(*source);
+
+    if (!source->_maskPath.empty())
+    {
+        layer->loadMask(source->_maskPath);
+    }
+
+    // Offset the copy so that it can be told apart.
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        layer->_warper.srcPoints[i] = source->_warper.srcPoints[i];
+        layer->_warper.dstPoints[i] = source->_warper.dstPoints[i] + ofPoint(20, 20);
+    }
+
+    layer->_warpMesh = source->_warpMesh;
+    layer->setColorGrade(source->_colorGrade);
+    layer->_lut = source->_lut;
+    layer->_lutPath = source->_lutPath;
+    layer->setMaskDecay(source->_maskDecay);
+    layer->setMaskGrowth(source->_maskGrowth);
+
+    _layerIndex.add(_layers.add(layer));
+    _isDamaged = true;
+}
+
+
+const PresentationClock& Project::getClock() const
+{
+    return _clock;
+}
+
+
+void Project::toggleStats()
+{
+    _showStats = !_showStats;
+}
+
+
+bool Project::isDamaged() const
+{
+    return _isDamaged;
+}
+
+
+void Project::clearDamage()
+{
+    _isDamaged = false;
 }
 
 
@@ -730,7 +1193,7 @@ Json::Value Project::toJSON(const Project& object)
 {
     Json::Value json;
 
-    std::deque<std::shared_ptr<Layer> >::const_iterator iter = object._layers.begin();
+    LayerStore::const_iterator iter = object._layers.begin();
 
     while (iter != object._layers.end())
     {
@@ -760,12 +1223,37 @@ bool Project::fromJSON(const Json::Value& json, Project& object)
             }
             else
             {
-                object._layers.push_back(pLayer);
+                object._layers.add(pLayer);
+                object._isDamaged = true;
+            }
+
+        }
+
+        // Instances share the source of their layer once all are loaded.
+        LayerStore::const_iterator iter = object._layers.begin();
+
+        while (iter != object._layers.end())
+        {
+            if (!(*iter)->getInstanceOf().isNull())
+            {
+                const std::shared_ptr<Layer>& source = object._layers.get(object._layers.find((*iter)->getInstanceOf()));
+
+                if (source && source->_video)
+                {
+                    (*iter)->setInstanceOf(*source);
+                }
+                else
+                {
+                    ofLogWarning("Project::fromJSON") << "Instance source not found: " << (*iter)->getInstanceOf().toString();
+                }
             }
 
+            ++iter;
         }
     }
 
+    object.indexLayers();
+
     return true;
 }
 
@@ -782,20 +1270,16 @@ void Project::keyPressed(ofKeyEventArgs& key)
     {
         if ('x' == key.key)
         {
-            std::deque<std::shared_ptr<Layer> >::const_iterator iter = _layers.begin();
-
-            while (iter != _layers.end())
-            {
-                if ((*iter))
-                {
-                    if ((*iter)->_video)
-                    {
-                        (*iter)->_video->setPosition(0);
-                    }
-                }
-
-                ++iter;
-            }
+            restart();
+        }
+        else if ('d' == key.key || 4 == key.key /* win hack */)
+        {
+            toggleStats();
+        }
+        else if ('i' == key.key || 9 == key.key /* win hack */)
+        {
+            ofPoint mouse(ofGetMouseX(), ofGetMouseY());
+            newInstanceOfLayerAtPoint(mouse);
         }
         else if (OF_KEY_DEL == key.key || OF_KEY_BACKSPACE == key.key)
         {
@@ -898,6 +1382,8 @@ void Project::mouseReleased(ofMouseEventArgs& mouse)
             _dragging->scale(mult);
         }
 
+        _layerIndex.update(_layers.find(_dragging->getId()));
+
         _dragging.reset();
     }
 }
@@ -32,6 +32,10 @@
 #include "ofVideoPlayer.h"
 #include "ofFbo.h"
 #include "Layer.h"
+#include "LayerBatch.h"
+#include "LayerIndex.h"
+#include "LayerStore.h"
+#include "PresentationClock.h"
 #include "AbstractTypes.h"
 #include "ofxMediaType.h"
 //#include "ofxLibav.h"
@@ -60,6 +64,19 @@ public:
         LAYER_SHIFT_BOTTOM
     };
 
+    enum
+    {
+        /// \brief The time a source must be invisible before its decoding
+        /// is suspended, in milliseconds.
+        SUSPEND_DELAY_MILLIS = 2000,
+        /// \brief The time a source must be small enough before its
+        /// resolution is lowered, in milliseconds.
+        DOWNSCALE_DELAY_MILLIS = 1000,
+        /// \brief The stencil rank of the top layer. Only this many layers
+        /// from the top draw their opaque mask tiles first.
+        MAX_STENCIL_RANK = 255
+    };
+
     /// \brief Create a project.
     /// \param parent A reference to the Project's parent.
     Project(AbstractApp& parent);
@@ -106,7 +123,7 @@ public:
     /// \brief Shift the layer in the stack.
     /// \param layer The layer to shift.
     /// \param shift The type of layer shift to apply to layer.
-    void shiftLayer(Layer::SharedPtr layer, LayerShift shift);
+    void shiftLayer(const Layer::SharedPtr& layer, LayerShift shift);
 
     /// \brief Get the layer at point.
     /// \param point The point used to get the layer by.
@@ -135,8 +152,22 @@ public:
     /// \returns true if project is loaded.
     bool isLoaded() const;
 
+    /// \brief Determine if any layer corner is at a point.
+    /// \param point The point to test.
+    /// \returns true if a corner of any layer is at the point.
     bool isCornerHovered(const ofPoint& point) const;
 
+    /// \brief Get the top layer under the mouse.
+    ///
+    /// Resolved once per frame by update() so that drawing the layers does
+    /// not hit test every layer again.
+    ///
+    /// \returns the hovered layer or nullptr if none.
+    const Layer::SharedPtr& getHoveredLayer() const;
+
+    /// \returns true if a layer corner was under the mouse at the last update().
+    bool isCornerHovered() const;
+
     /// \brief Get the state of the mouse brush.
     /// \returns True if the mask brush is enabled.
     bool isMaskBrushEnabled();
@@ -147,6 +178,58 @@ public:
     /// \brief Disable the mask brush.
     void disableMaskBrush();
 
+    /// \brief Restart all video sources from the start of the timeline.
+    ///
+    /// The presentation clock is held until every source has prerolled its
+    /// first frame so that all layers jump on the same frame.
+    void restart();
+
+    /// \brief Get the video source for a video, shared by all layers.
+    ///
+    /// Layers that play the same video at the same time offset share one
+    /// decoder and texture, which keeps them on the same frame.
+    ///
+    /// \param path The absolute path to the video.
+    /// \param timeOffset The time offset in seconds added to the clock.
+    /// \param cacheEnabled true to cache the decoded video if possible.
+    /// \returns the source or nullptr if the video could not be loaded.
+    VideoSource::SharedPtr getVideoSource(const std::string& path,
+                                          double timeOffset,
+                                          bool cacheEnabled);
+
+    /// \brief Create an instance of a layer.
+    ///
+    /// The instance shares the video source of the layer and gets its own
+    /// copy of the mask and warp.
+    ///
+    /// \param point The point used to select the layer.
+    void newInstanceOfLayerAtPoint(const ofPoint& point);
+
+    /// \returns the project presentation clock.
+    const PresentationClock& getClock() const;
+
+    /// \brief Toggle the on-screen layer statistics.
+    void toggleStats();
+
+    /// \brief Set the size of the canvas the project is drawn into.
+    ///
+    /// Layers entirely outside the canvas are culled in present mode.
+    ///
+    /// \param width The canvas width in pixels.
+    /// \param height The canvas height in pixels.
+    void setCanvasSize(float width, float height);
+
+    /// \brief Check if anything visible changed since the damage was cleared.
+    ///
+    /// The project is damaged when any layer is dirty or layers were added,
+    /// removed or reordered.
+    ///
+    /// \returns true if the project needs to be drawn again.
+    bool isDamaged() const;
+
+    /// \brief Mark the project as drawn.
+    void clearDamage();
+
     /// \brief Get the project name.
     /// \returns the project name.
     std::string getName() const;
@@ -192,11 +275,135 @@ private:
     bool _isLoaded;
     bool _maskBrushEnabled;
 
+    /// \brief true iff layer statistics are drawn.
+    bool _showStats;
+
+    /// \brief true iff the project changed since the damage was cleared.
+    bool _isDamaged;
+
+    /// \brief Rebuild the layer index from the layer store.
+    void indexLayers();
+
+    /// \brief Resolve the hovered layer and corner for this frame.
+    void updateHover();
+
+    /// \brief Draw the layers, batching layers that share a source.
+    void drawBatched();
+
+    /// \brief Resolve which layers are visible for this frame.
+    ///
+    /// In present mode, layers that are hidden, outside the canvas or
+    /// covered by an opaque layer above are invisible. In edit mode all
+    /// layers are visible.
+    void updateVisibility();
+
+    /// \brief The canvas bounds.
+    ofRectangle _canvasBounds;
+
+    /// \brief The sources of the visible layers with the downscale level
+    /// each layer needs, sorted.
+    std::vector<std::pair<const VideoSource*, int> > _visibleSources;
+
+    /// \brief The opaque visible layers above the current layer, reused
+    /// while resolving visibility.
+    std::vector<const Layer*> _occluders;
+
+    /// \brief The layer batches, reused from frame to frame.
+    std::vector<std::shared_ptr<LayerBatch> > _batches;
+
+    /// \brief A layer or batch to draw.
+    struct DrawItem
+    {
+        DrawItem(Layer* layer_, LayerBatch* batch_, std::size_t order_):
+            layer(layer_),
+            batch(batch_),
+            order(order_),
+            rank(0)
+        {
+        }
+
+        /// \brief The layer, or nullptr for a batch.
+        Layer* layer;
+
+        /// \brief The batch, or nullptr for a layer.
+        LayerBatch* batch;
+
+        /// \brief The position of the (first) layer among visible layers.
+        std::size_t order;
+
+        /// \brief The stencil rank, higher above.
+        int rank;
+    };
+
+    /// \brief The layers and batches to draw this frame, in order.
+    std::vector<DrawItem> _drawList;
+
+    /// \brief The top layer under the mouse at the last update().
+    Layer::SharedPtr _hoveredLayer;
+
+    /// \brief true iff a layer corner was under the mouse at the last update().
+    bool _isCornerHovered;
+
+    /// \brief The CPU time of the last update() in microseconds.
+    uint64_t _updateMicros;
+
+    /// \brief The CPU time of the last update() and draw() in microseconds.
+    uint64_t _frameMicros;
+
+    /// \brief A running average of the frame CPU time in microseconds.
+    double _averageFrameMicros;
+
     /// \brief The project path.
     Poco::Path _path;
 
     /// \brief The layers.
-    std::deque<Layer::SharedPtr> _layers;
+    LayerStore _layers;
+
+    /// \brief The spatial index used to pick layers.
+    LayerIndex _layerIndex;
+
+    /// \brief A video source shared by layers.
+    struct SharedSource
+    {
+        SharedSource():
+            timeOffset(0),
+            lastVisibleMillis(0),
+            isSuspended(false),
+            isResuming(false),
+            downscale(0),
+            downscaleMillis(0)
+        {
+        }
+
+        /// \brief The source, released with the last layer using it.
+        std::weak_ptr<VideoSource> source;
+
+        /// \brief The time offset in seconds added to the clock.
+        double timeOffset;
+
+        /// \brief The time a layer using the source was last visible.
+        uint64_t lastVisibleMillis;
+
+        /// \brief true while the source is not updated because no layer
+        /// using it is visible.
+        bool isSuspended;
+
+        /// \brief true while a resumed source prerolls its first frame.
+        bool isResuming;
+
+        /// \brief The downscale level requested from the source.
+        int downscale;
+
+        /// \brief The time the visible layers last needed a resolution at
+        /// least as high as the requested one.
+        uint64_t downscaleMillis;
+    };
+
+    /// \brief The presentation clock shared by all layers.
+    PresentationClock _clock;
+
+    /// \brief The video sources by path and time offset.
+    std::map<std::string, SharedSource> _sources;
 
     Layer::SharedPtr _dragging;
     ofPoint _dragStart;
@@ -0,0 +1,136 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "RenderTargetPool.h"
+#include "ofLog.h"
+
+
+namespace Kibio {
+
+
+RenderTargetPool::RenderTargetPool()
+{
+}
+
+
+RenderTargetPool::Target RenderTargetPool::acquire(int width, int height)
+{
+    int bucketWidth = toBucket(width);
+    int bucketHeight = toBucket(height);
+
+    std::vector<Target>::iterator iter = _targets.begin();
+    std::size_t unused = 0;
+
+    while (iter != _targets.end())
+    {
+        // Only the pool holds a reference to unused targets.
+        if (iter->use_count() == 1)
+        {
+            if ((*iter)->getWidth() == bucketWidth && (*iter)->getHeight() == bucketHeight)
+            {
+                Target target = *iter;
+                _targets.erase(iter);
+                _targets.push_back(target);
+                return target;
+            }
+
+            ++unused;
+        }
+
+        ++iter;
+    }
+
+    // Drop the least recently acquired unused targets before allocating.
+    iter = _targets.begin();
+
+    while (iter != _targets.end() && unused >= MAX_UNUSED_TARGETS)
+    {
+        if (iter->use_count() == 1)
+        {
+            iter = _targets.erase(iter);
+            --unused;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    ofLogVerbose("RenderTargetPool::acquire") << "Allocating target: " << bucketWidth << " / " << bucketHeight;
+
+    Target target = std::make_shared<ofFbo>();
+    target->allocate(bucketWidth, bucketHeight, GL_RGBA, 0);
+    _targets.push_back(target);
+    return target;
+}
+
+
+bool RenderTargetPool::fits(const Target& target, int width, int height)
+{
+    return target &&
+           target->getWidth() == toBucket(width) &&
+           target->getHeight() == toBucket(height);
+}
+
+
+void RenderTargetPool::clearUnused()
+{
+    std::vector<Target>::iterator iter = _targets.begin();
+
+    while (iter != _targets.end())
+    {
+        if (iter->use_count() == 1)
+        {
+            iter = _targets.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+
+std::size_t RenderTargetPool::size() const
+{
+    return _targets.size();
+}
+
+
+RenderTargetPool& RenderTargetPool::getDefault()
+{
+    static RenderTargetPool pool;
+    return pool;
+}
+
+
+int RenderTargetPool::toBucket(int size)
+{
+    return std::max(1, (size + BUCKET_SIZE - 1) / BUCKET_SIZE) * BUCKET_SIZE;
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,98 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofFbo.h"
+
+
+namespace Kibio {
+
+
+/// \brief A shared pool of intermediate render targets.
+///
+/// Targets are allocated in size buckets, rounded up to a multiple of
+/// BUCKET_SIZE pixels, and are handed out as shared pointers. A target is
+/// back in the pool as soon as its last user releases it, so layers that
+/// change resolution or composite mode reuse existing targets instead of
+/// allocating new ones. Targets are usually larger than requested, so only
+/// the requested region holds valid pixels. Callers must map texture
+/// coordinates to that region, for example with a texture matrix set by
+/// ofTexture::setTextureMatrix() while the target is bound, and must not
+/// sample beyond it.
+class RenderTargetPool
+{
+public:
+    /// \brief A typedef for a shared render target.
+    typedef std::shared_ptr<ofFbo> Target;
+
+    /// \brief Create an empty RenderTargetPool.
+    RenderTargetPool();
+
+    /// \brief Get a target at least as large as the given size.
+    /// \param width The minimum width in pixels.
+    /// \param height The minimum height in pixels.
+    /// \returns a target that is not used by anyone else.
+    Target acquire(int width, int height);
+
+    /// \brief Check if a target is in the bucket for a size.
+    /// \param target The target to check.
+    /// \param width The requested width in pixels.
+    /// \param height The requested height in pixels.
+    /// \returns true if acquire() would return a target of the same size.
+    static bool fits(const Target& target, int width, int height);
+
+    /// \brief Release all targets that are not in use.
+    void clearUnused();
+
+    /// \returns the total number of allocated targets.
+    std::size_t size() const;
+
+    /// \returns the pool shared by all layers.
+    static RenderTargetPool& getDefault();
+
+    enum
+    {
+        /// \brief The bucket granularity in pixels.
+        BUCKET_SIZE = 128,
+        /// \brief The number of unused targets kept for reuse.
+        MAX_UNUSED_TARGETS = 4
+    };
+
+private:
+    /// \brief Round a size up to its bucket.
+    /// \param size The size in pixels.
+    /// \returns the bucket size in pixels.
+    static int toBucket(int size);
+
+    /// \brief All allocated targets, least recently acquired first.
+    std::vector<Target> _targets;
+
+};
+
+
+} // namespace Kibio
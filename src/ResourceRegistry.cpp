@@ -0,0 +1,163 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "ResourceRegistry.h"
+#include "Poco/File.h"
+#include "ofImage.h"
+#include "ofLog.h"
+#include "ofUtils.h"
+
+
+namespace Kibio {
+
+
+ResourceRegistry::ResourceRegistry()
+{
+}
+
+
+std::shared_ptr<ofShader> ResourceRegistry::getShader(const std::string& path)
+{
+    std::shared_ptr<ofShader> shader = _shaders[path].lock();
+
+    if (!shader)
+    {
+        shader = std::make_shared<ofShader>();
+
+        if (!shader->load(path))
+        {
+            ofLogError("ResourceRegistry::getShader") << "Unable to load shader: " << path;
+        }
+
+        _shaders[path] = shader;
+    }
+
+    return shader;
+}
+
+
+std::shared_ptr<ofTexture> ResourceRegistry::getTexture(const std::string& path)
+{
+    std::string key = getFileKey(path);
+
+    std::shared_ptr<ofTexture> texture = _textures[key].lock();
+
+    if (!texture)
+    {
+        texture = std::make_shared<ofTexture>();
+
+        if (!ofLoadImage(*texture, path))
+        {
+            ofLogError("ResourceRegistry::getTexture") << "Unable to load texture: " << path;
+            _textures.erase(key);
+            return nullptr;
+        }
+
+        _textures[key] = texture;
+    }
+
+    // Forget textures that are no longer used by anyone.
+    std::map<std::string, std::weak_ptr<ofTexture> >::iterator iter = _textures.begin();
+
+    while (iter != _textures.end())
+    {
+        if (iter->second.expired())
+        {
+            _textures.erase(iter++);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    return texture;
+}
+
+
+std::shared_ptr<Lut3D> ResourceRegistry::getLut(const std::string& path)
+{
+    std::string key = getFileKey(path);
+
+    std::shared_ptr<Lut3D> lut = _luts[key].lock();
+
+    if (!lut)
+    {
+        lut = std::make_shared<Lut3D>();
+
+        if (!lut->load(path))
+        {
+            ofLogError("ResourceRegistry::getLut") << "Unable to load lookup table: " << path;
+            _luts.erase(key);
+            return nullptr;
+        }
+
+        _luts[key] = lut;
+    }
+
+    // Forget tables that are no longer used by anyone.
+    std::map<std::string, std::weak_ptr<Lut3D> >::iterator iter = _luts.begin();
+
+    while (iter != _luts.end())
+    {
+        if (iter->second.expired())
+        {
+            _luts.erase(iter++);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    return lut;
+}
+
+
+ResourceRegistry& ResourceRegistry::getDefault()
+{
+    static ResourceRegistry registry;
+    return registry;
+}
+
+
+std::string ResourceRegistry::getFileKey(const std::string& path)
+{
+    std::string absolutePath = ofToDataPath(path, true);
+
+    try
+    {
+        Poco::File file(absolutePath);
+        return absolutePath + "@" + ofToString(file.getLastModified().epochMicroseconds());
+    }
+    catch (const Poco::Exception& exc)
+    {
+        return absolutePath;
+    }
+}
+
+
+} // namespace Kibio
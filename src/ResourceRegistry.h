@@ -0,0 +1,88 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <map>
+#include "ofShader.h"
+#include "ofTexture.h"
+#include "Lut3D.h"
+
+
+namespace Kibio {
+
+
+/// \brief Shares GPU resources loaded from files.
+///
+/// Shader programs, textures and colour lookup tables are cached by path and
+/// shared between all users. The registry only holds weak references, so a
+/// resource is released once its last user releases it. Textures and lookup
+/// tables are also keyed by the file modification time, so an edited file is
+/// loaded again.
+class ResourceRegistry
+{
+public:
+    /// \brief Create an empty ResourceRegistry.
+    ResourceRegistry();
+
+    /// \brief Get a shader program, compiling it on first use.
+    /// \param path The shader path without extension, relative to bin/data.
+    /// \returns the shader.
+    std::shared_ptr<ofShader> getShader(const std::string& path);
+
+    /// \brief Get a texture, loading it on first use.
+    /// \param path The image path, absolute or relative to bin/data.
+    /// \returns the texture or nullptr if it could not be loaded.
+    std::shared_ptr<ofTexture> getTexture(const std::string& path);
+
+    /// \brief Get a 3D colour lookup table, loading it on first use.
+    /// \param path The .cube path, absolute or relative to bin/data.
+    /// \returns the table or nullptr if it could not be loaded.
+    std::shared_ptr<Lut3D> getLut(const std::string& path);
+
+    /// \returns the registry shared by all projects.
+    static ResourceRegistry& getDefault();
+
+private:
+    /// \brief Get the cache key for a file.
+    /// \param path The file path.
+    /// \returns the absolute path and modification time.
+    static std::string getFileKey(const std::string& path);
+
+    /// \brief The shaders by path.
+    std::map<std::string, std::weak_ptr<ofShader> > _shaders;
+
+    /// \brief The textures by path and modification time.
+    std::map<std::string, std::weak_ptr<ofTexture> > _textures;
+
+    /// \brief The lookup tables by path and modification time.
+    std::map<std::string, std::weak_ptr<Lut3D> > _luts;
+
+};
+
+
+} // namespace Kibio
@@ -25,6 +25,7 @@
 
 
 #include "SimpleApp.h"
+#include "VideoDecoder.h"
 #include "Poco/Environment.h"
 #include "Poco/FileStream.h"
 #include "ofLog.h"
@@ -47,7 +48,10 @@ SimpleApp::SimpleApp():
 	_version(SETTINGS_VERSION),
     _mode(EDIT),
 	_logger(std::make_shared<EventLoggerChannel>()),
-    _logDuration(5)
+    _logDuration(5),
+    _isCanvasValid(false),
+    _canvasWidth(0),
+    _canvasHeight(0)
 {
 }
 
@@ -105,6 +109,8 @@ void SimpleApp::exit()
     }
 
     saveSettings();
+
+    RenderTargetPool::getDefault().clearUnused();
 }
 
 
@@ -112,11 +118,19 @@ void SimpleApp::update()
 {
     if (_currentProject)
     {
+        _currentProject->setCanvasSize(_canvasWidth > 0 ? _canvasWidth : ofGetWidth(),
+                                       _canvasHeight > 0 ? _canvasHeight : ofGetHeight());
         _currentProject->update();
     }
     
     _ui.update();
 
+    // Layers are edited in the undistorted canvas.
+    if (_mode != PRESENT && _output.isEditing())
+    {
+        _output.setEditing(false);
+    }
+
     std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
 
     auto i = _log.begin();
@@ -188,7 +202,23 @@ void SimpleApp::draw()
 
     if (_currentProject)
     {
-        _currentProject->draw();
+        renderCanvas();
+
+        if (PRESENT == _mode)
+        {
+            _output.draw(_canvas.getTexture());
+        }
+        else
+        {
+            // Layers are edited in canvas space, drawn 1:1 over the background.
+            ofPushStyle();
+            ofEnableAlphaBlending();
+            ofSetColor(255);
+            _canvas.draw(0, 0);
+            ofPopStyle();
+
+            drawPreview();
+        }
     }
 
     ofSetColor(255);
@@ -206,6 +236,74 @@ void SimpleApp::draw()
 }
 
 
+void SimpleApp::renderCanvas()
+{
+    int width = _canvasWidth > 0 ? _canvasWidth : ofGetWidth();
+    int height = _canvasHeight > 0 ? _canvasHeight : ofGetHeight();
+
+    if (_canvas.getWidth() != width || _canvas.getHeight() != height)
+    {
+        // The stencil lets opaque mask tiles hide the layers below them.
+        ofFbo::Settings settings;
+        settings.width = width;
+        settings.height = height;
+        settings.internalformat = GL_RGBA;
+        settings.useDepth = true;
+        settings.useStencil = true;
+        _canvas.allocate(settings);
+        _isCanvasValid = false;
+    }
+
+    // Edit mode overlays follow the mouse, so they are drawn every frame.
+    if (EDIT == _mode || !_isCanvasValid || _currentProject->isDamaged())
+    {
+        _canvas.begin();
+        ofClear(0, 0, 0, EDIT == _mode ? 0 : 255);
+        ofSetColor(255);
+        _currentProject->draw();
+        _canvas.end();
+
+        _currentProject->clearDamage();
+        _isCanvasValid = (PRESENT == _mode);
+    }
+}
+
+
+void SimpleApp::drawPreview()
+{
+    // Only needed when part of the canvas is outside of the window.
+    if (_canvas.getWidth() <= ofGetWidth() && _canvas.getHeight() <= ofGetHeight())
+    {
+        return;
+    }
+
+    ofRectangle preview(0, 0, _canvas.getWidth(), _canvas.getHeight());
+    preview.scaleTo(ofRectangle(0,
+                                0,
+                                ofGetWidth() * PREVIEW_SCALE_PERCENT / 100.0f,
+                                ofGetHeight() * PREVIEW_SCALE_PERCENT / 100.0f));
+    preview.setPosition(ofGetWidth() - preview.getWidth() - PREVIEW_MARGIN,
+                        ofGetHeight() - preview.getHeight() - PREVIEW_MARGIN);
+
+    // The GPU filters the canvas down, no extra pass is needed.
+    ofPushStyle();
+    ofSetColor(0);
+    ofDrawRectangle(preview);
+    ofSetColor(255);
+    _canvas.draw(preview.getX(), preview.getY(), preview.getWidth(), preview.getHeight());
+    ofNoFill();
+    ofSetColor(255, 127);
+    ofDrawRectangle(preview);
+
+    // The part of the canvas shown in the window.
+    ofDrawRectangle(preview.getX(),
+                    preview.getY(),
+                    preview.getWidth() * ofGetWidth() / _canvas.getWidth(),
+                    preview.getHeight() * ofGetHeight() / _canvas.getHeight());
+    ofPopStyle();
+}
+
+
 void SimpleApp::keyPressed(ofKeyEventArgs& key)
 {
 #if defined(TARGET_OSX)
@@ -242,6 +340,13 @@ void SimpleApp::keyPressed(ofKeyEventArgs& key)
         {
             ofToggleFullscreen();
         }
+        else if ('p' == key.key || 16 == key.key /* win hack */)
+        {
+            if (PRESENT == _mode)
+            {
+                _output.setEditing(!_output.isEditing());
+            }
+        }
         else if ('o' == key.key || 15 == key.key /* win hack */)
         {
 			cout << "opening new project " << endl;
@@ -718,6 +823,38 @@ bool SimpleApp::fromJSON(const Json::Value& json, SimpleApp& object)
 
     object._version = json.get("version", 0).asInt();
 
+    // The budget must be set before any layer video is loaded.
+    if (json.isMember("cache"))
+    {
+        VideoDecoder::setCacheBudget(json["cache"].get("budget", 512).asUInt() * 1024ull * 1024ull);
+    }
+
+    if (json.isMember("canvas"))
+    {
+        object._canvasWidth = json["canvas"].get("width", 0).asInt();
+        object._canvasHeight = json["canvas"].get("height", 0).asInt();
+    }
+
+    // The first output is the main window, the others open their own window.
+    if (json.isMember("outputs"))
+    {
+        const Json::Value& outputs = json["outputs"];
+
+        object._outputWindows.clear();
+
+        for (Json::ArrayIndex i = 0; i < outputs.size(); ++i)
+        {
+            if (0 == i)
+            {
+                Output::fromJSON(outputs[i], object._output);
+            }
+            else
+            {
+                object._outputWindows.push_back(std::make_shared<OutputWindow>(object._canvas, outputs[i]));
+            }
+        }
+    }
+
     if (json.isMember("project"))
     {
         // TODO: load default project if last open project has been deleted
@@ -757,6 +894,18 @@ Json::Value SimpleApp::toJSON(const SimpleApp& object)
 
     json["version"] = object._version;
 
+    json["cache"]["budget"] = Json::UInt(VideoDecoder::getCacheBudget() / (1024 * 1024));
+
+    json["canvas"]["width"] = object._canvasWidth;
+    json["canvas"]["height"] = object._canvasHeight;
+
+    json["outputs"].append(Output::toJSON(object._output));
+
+    for (std::size_t i = 0; i < object._outputWindows.size(); ++i)
+    {
+        json["outputs"].append(OutputWindow::toJSON(*object._outputWindows[i]));
+    }
+
     if (object._currentProject && object._currentProject->isLoaded())
     {
         json["project"] = object._currentProject->getName();
@@ -32,6 +32,8 @@
 #include "ofMain.h"
 #include "UserInterface.h"
 #include "Project.h"
+#include "Output.h"
+#include "OutputWindow.h"
 #include "AbstractTypes.h"
 #include "EventLoggerChannel.h"
 
@@ -211,6 +213,16 @@ public:
     }
 
 protected:
+    /// \brief Composite the project into the canvas.
+    ///
+    /// In present mode the layers are only composited again when the project
+    /// is damaged, otherwise the previous frame is presented. All outputs
+    /// present the same canvas.
+    void renderCanvas();
+
+    /// \brief Draw a scaled down view of the whole canvas in edit mode.
+    void drawPreview();
+
     /// \brief The current app mode.
     Mode _mode;
 
@@ -248,6 +260,32 @@ protected:
     /// \brief A log duration of 5 seconds.
     std::chrono::seconds _logDuration;
 
+    /// \brief The composited project, reused while the project is undamaged.
+    ofFbo _canvas;
+
+    /// \brief true iff the canvas holds the current project.
+    bool _isCanvasValid;
+
+    /// \brief The canvas width in pixels, or 0 to follow the window.
+    int _canvasWidth;
+
+    /// \brief The canvas height in pixels, or 0 to follow the window.
+    int _canvasHeight;
+
+    /// \brief Presents the canvas in the main window.
+    Output _output;
+
+    /// \brief The additional output windows.
+    std::vector<OutputWindow::SharedPtr> _outputWindows;
+
+    enum
+    {
+        /// \brief The maximum size of the canvas preview relative to the window.
+        PREVIEW_SCALE_PERCENT = 25,
+        /// \brief The distance of the preview from the window edges in pixels.
+        PREVIEW_MARGIN = 14
+    };
+
 
 };
 
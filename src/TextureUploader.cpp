@@ -0,0 +1,291 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "TextureUploader.h"
+#include "ofGLUtils.h"
+#include "ofUtils.h"
+
+
+namespace Kibio {
+
+
+TextureUploader::Stats::Stats():
+    lastMicros(0),
+    averageMicros(0),
+    uploads(0),
+    stalls(0)
+{
+}
+
+
+TextureUploader::TextureUploader():
+    _index(0)
+{
+    for (std::size_t i = 0; i < NUM_BUFFERS; ++i)
+    {
+        _fences[i] = nullptr;
+    }
+}
+
+
+TextureUploader::~TextureUploader()
+{
+    for (std::size_t i = 0; i < NUM_BUFFERS; ++i)
+    {
+        if (_fences[i])
+        {
+            glDeleteSync(_fences[i]);
+        }
+    }
+}
+
+
+void TextureUploader::upload(const ofPixels& pixels, std::vector<ofTexture>& textures)
+{
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    std::vector<Plane> planes = getPlanes(pixels);
+
+    if (planes.empty())
+    {
+        ofLogError("TextureUploader::upload") << "Unsupported pixel format: " << pixels.getPixelFormat();
+        return;
+    }
+
+    textures.resize(planes.size());
+
+    for (std::size_t i = 0; i < planes.size(); ++i)
+    {
+        const Plane& plane = planes[i];
+        ofTexture& texture = textures[i];
+
+        if (!texture.isAllocated() ||
+            texture.getWidth() != plane.width ||
+            texture.getHeight() != plane.height)
+        {
+            texture.allocate(plane.width,
+                             plane.height,
+                             plane.glInternalFormat,
+                             plane.glFormat,
+                             GL_UNSIGNED_BYTE);
+
+            if (planes.size() > 1)
+            {
+                // Sample the raw channels rather than luminance swizzles.
+                const ofTextureData& data = texture.getTextureData();
+                glBindTexture(data.textureTarget, data.textureID);
+                glTexParameteri(data.textureTarget, GL_TEXTURE_SWIZZLE_R, GL_RED);
+                glTexParameteri(data.textureTarget, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
+                glTexParameteri(data.textureTarget, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
+                glTexParameteri(data.textureTarget, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
+                glBindTexture(data.textureTarget, 0);
+            }
+        }
+    }
+
+    const unsigned char* source = beginUpload(pixels.getData(), pixels.getTotalBytes());
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (std::size_t i = 0; i < planes.size(); ++i)
+    {
+        const Plane& plane = planes[i];
+        const ofTextureData& textureData = textures[i].getTextureData();
+
+        glBindTexture(textureData.textureTarget, textureData.textureID);
+        glTexSubImage2D(textureData.textureTarget,
+                        0,
+                        0,
+                        0,
+                        plane.width,
+                        plane.height,
+                        plane.glFormat,
+                        GL_UNSIGNED_BYTE,
+                        source + plane.offset);
+        glBindTexture(textureData.textureTarget, 0);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    endUpload(source, start);
+}
+
+
+void TextureUploader::uploadCompressed(const unsigned char* data,
+                                       std::size_t size,
+                                       int width,
+                                       int height,
+                                       int glInternalFormat,
+                                       ofTexture& texture)
+{
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    if (!texture.isAllocated() ||
+        texture.getWidth() != width ||
+        texture.getHeight() != height ||
+        texture.getTextureData().glInternalFormat != glInternalFormat)
+    {
+        ofTextureData textureData;
+        textureData.width = width;
+        textureData.height = height;
+        textureData.textureTarget = GL_TEXTURE_2D;
+        textureData.glInternalFormat = glInternalFormat;
+        texture.allocate(textureData, GL_RGBA, GL_UNSIGNED_BYTE);
+    }
+
+    const unsigned char* source = beginUpload(data, size);
+
+    const ofTextureData& textureData = texture.getTextureData();
+
+    // The blocks are copied as they are, without decoding.
+    glBindTexture(textureData.textureTarget, textureData.textureID);
+    glCompressedTexSubImage2D(textureData.textureTarget,
+                              0,
+                              0,
+                              0,
+                              width,
+                              height,
+                              glInternalFormat,
+                              size,
+                              source);
+    glBindTexture(textureData.textureTarget, 0);
+
+    endUpload(source, start);
+}
+
+
+const TextureUploader::Stats& TextureUploader::getStats() const
+{
+    return _stats;
+}
+
+
+const unsigned char* TextureUploader::beginUpload(const unsigned char* data, std::size_t size)
+{
+    ofBufferObject& buffer = _buffers[_index];
+    GLsync& fence = _fences[_index];
+
+    if (fence)
+    {
+        // Make sure the GPU is done reading from this buffer.
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ++_stats.stalls;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (!buffer.isAllocated() || buffer.size() != size)
+    {
+        buffer.allocate(size, GL_STREAM_DRAW);
+    }
+
+    void* mapped = buffer.mapRange(0,
+                                   size,
+                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    if (!mapped)
+    {
+        ofLogError("TextureUploader::beginUpload") << "Unable to map pixel buffer, uploading synchronously.";
+        return data;
+    }
+
+    std::memcpy(mapped, data, size);
+    buffer.unmapRange();
+    buffer.bind(GL_PIXEL_UNPACK_BUFFER);
+
+    // With a bound pixel buffer the data pointer is an offset into it.
+    return nullptr;
+}
+
+
+void TextureUploader::endUpload(const unsigned char* source, uint64_t start)
+{
+    if (!source)
+    {
+        _buffers[_index].unbind(GL_PIXEL_UNPACK_BUFFER);
+        _fences[_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _index = (_index + 1) % NUM_BUFFERS;
+    }
+
+    _stats.lastMicros = ofGetElapsedTimeMicros() - start;
+    _stats.averageMicros = _stats.uploads == 0 ? _stats.lastMicros : _stats.averageMicros * 0.95 + _stats.lastMicros * 0.05;
+    ++_stats.uploads;
+}
+
+
+std::vector<TextureUploader::Plane> TextureUploader::getPlanes(const ofPixels& pixels)
+{
+    std::vector<Plane> planes;
+
+    int width = pixels.getWidth();
+    int height = pixels.getHeight();
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    std::size_t lumaSize = width * height;
+    std::size_t chromaSize = chromaWidth * chromaHeight;
+
+    switch (pixels.getPixelFormat())
+    {
+        case OF_PIXELS_NV12:
+        {
+            Plane y = { 0, width, height, GL_R8, GL_RED };
+            Plane uv = { lumaSize, chromaWidth, chromaHeight, GL_RG8, GL_RG };
+            planes.push_back(y);
+            planes.push_back(uv);
+            break;
+        }
+        case OF_PIXELS_I420:
+        {
+            Plane y = { 0, width, height, GL_R8, GL_RED };
+            Plane u = { lumaSize, chromaWidth, chromaHeight, GL_R8, GL_RED };
+            Plane v = { lumaSize + chromaSize, chromaWidth, chromaHeight, GL_R8, GL_RED };
+            planes.push_back(y);
+            planes.push_back(u);
+            planes.push_back(v);
+            break;
+        }
+        case OF_PIXELS_RGB:
+        case OF_PIXELS_BGR:
+        case OF_PIXELS_RGBA:
+        case OF_PIXELS_BGRA:
+        {
+            Plane rgb = { 0, width, height, ofGetGLInternalFormat(pixels), ofGetGLFormat(pixels) };
+            planes.push_back(rgb);
+            break;
+        }
+        default:
+            break;
+    }
+
+    return planes;
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,161 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofBufferObject.h"
+#include "ofPixels.h"
+#include "ofTexture.h"
+
+
+namespace Kibio {
+
+
+/// \brief Streams pixels into textures through a ring of pixel buffer objects.
+///
+/// Each upload copies the pixels into the next pixel buffer object and starts
+/// an asynchronous transfer into one texture per pixel plane. Planar YUV
+/// pixels (NV12, I420) are uploaded as separate single or dual channel
+/// textures so that they can be converted to RGB in a shader. Block
+/// compressed frames are uploaded to compressed textures as they are.
+///
+/// A fence guards every buffer so that it is only rewritten once the GPU has
+/// finished reading from it, which lets the copy for frame N + 1 overlap
+/// drawing frame N.
+class TextureUploader
+{
+public:
+    /// \brief Upload timing statistics.
+    struct Stats
+    {
+        Stats();
+
+        /// \brief The CPU time of the last upload in microseconds.
+        uint64_t lastMicros;
+
+        /// \brief A running average of the upload CPU time in microseconds.
+        double averageMicros;
+
+        /// \brief The total number of uploads.
+        uint64_t uploads;
+
+        /// \brief The number of uploads that had to wait for the GPU.
+        uint64_t stalls;
+    };
+
+    /// \brief A single plane of a pixel layout.
+    struct Plane
+    {
+        /// \brief The byte offset of the plane in the pixel data.
+        std::size_t offset;
+
+        /// \brief The plane width in pixels.
+        int width;
+
+        /// \brief The plane height in pixels.
+        int height;
+
+        /// \brief The GL internal format of the plane texture.
+        int glInternalFormat;
+
+        /// \brief The GL format of the plane data.
+        int glFormat;
+    };
+
+    /// \brief Create a TextureUploader.
+    TextureUploader();
+
+    /// \brief Destroy the TextureUploader.
+    ~TextureUploader();
+
+    /// \brief Upload pixels into one texture per pixel plane.
+    ///
+    /// Textures are (re)allocated if they do not match the planes.
+    ///
+    /// \param pixels The pixels to upload.
+    /// \param textures The destination textures, resized to the plane count.
+    void upload(const ofPixels& pixels, std::vector<ofTexture>& textures);
+
+    /// \brief Upload block compressed texture data.
+    ///
+    /// The texture is (re)allocated as a GL_TEXTURE_2D if it does not match.
+    ///
+    /// \param data The compressed blocks.
+    /// \param size The size of the compressed blocks in bytes.
+    /// \param width The texture width in pixels, a multiple of 4.
+    /// \param height The texture height in pixels, a multiple of 4.
+    /// \param glInternalFormat The compressed GL internal format.
+    /// \param texture The destination texture.
+    void uploadCompressed(const unsigned char* data,
+                          std::size_t size,
+                          int width,
+                          int height,
+                          int glInternalFormat,
+                          ofTexture& texture);
+
+    /// \returns the upload timing statistics.
+    const Stats& getStats() const;
+
+    /// \brief Get the texture planes for pixels.
+    /// \param pixels The pixels to describe.
+    /// \returns the planes, or an empty collection if unsupported.
+    static std::vector<Plane> getPlanes(const ofPixels& pixels);
+
+    enum
+    {
+        /// \brief The number of pixel buffer objects in flight.
+        NUM_BUFFERS = 3
+    };
+
+private:
+    /// \brief Copy data into the next pixel buffer object and bind it.
+    /// \param data The data to upload.
+    /// \param size The size of the data in bytes.
+    /// \returns the pointer to pass to GL, nullptr if the buffer is bound or
+    ///     data if the buffer could not be mapped.
+    const unsigned char* beginUpload(const unsigned char* data, std::size_t size);
+
+    /// \brief Unbind and fence the pixel buffer object and update statistics.
+    /// \param source The pointer returned by beginUpload().
+    /// \param start The upload start time in microseconds.
+    void endUpload(const unsigned char* source, uint64_t start);
+
+    /// \brief The pixel buffer objects.
+    ofBufferObject _buffers[NUM_BUFFERS];
+
+    /// \brief A fence for each pixel buffer object, or nullptr.
+    GLsync _fences[NUM_BUFFERS];
+
+    /// \brief The index of the next buffer to write.
+    std::size_t _index;
+
+    Stats _stats;
+
+};
+
+
+} // namespace Kibio
@@ -0,0 +1,635 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "VideoDecoder.h"
+#include <algorithm>
+#include "ofLog.h"
+
+
+namespace Kibio {
+
+
+std::atomic<std::size_t> VideoDecoder::_cacheBudget(512 * 1024 * 1024);
+std::atomic<std::size_t> VideoDecoder::_cacheUsage(0);
+
+
+VideoDecoder::VideoDecoder():
+    _cachedFrames(0),
+    _cacheBytes(0),
+    _cacheFrameIndex(-1),
+    _downscale(0),
+    _isCacheEnabled(false),
+    _isCached(false),
+    _isLoaded(false),
+    _isFrameNew(false),
+    _width(0),
+    _height(0),
+    _duration(0),
+    _frameRate(0),
+    _totalNumFrames(0),
+    _pixelFormat(OF_PIXELS_RGB),
+    _colorMatrix(COLOR_MATRIX_AUTO)
+{
+}
+
+
+VideoDecoder::~VideoDecoder()
+{
+    close();
+}
+
+
+bool VideoDecoder::load(const std::string& path)
+{
+    close();
+
+    // Pixels are uploaded by the render thread, never by the player.
+    _player.setUseTexture(false);
+
+    if (!loadWithPreferredPixelFormat(path))
+    {
+        ofLogError("VideoDecoder::load") << "Unable to load video: " << path;
+        return false;
+    }
+
+    _player.setLoopState(OF_LOOP_NONE);
+    _player.play();
+    _player.setPaused(true);
+
+    _width = _player.getWidth();
+    _height = _player.getHeight();
+    _duration = _player.getDuration();
+    _totalNumFrames = _player.getTotalNumFrames();
+    _pixelFormat = _player.getPixelFormat();
+
+    if (_duration > 0 && _totalNumFrames > 0)
+    {
+        _frameRate = _totalNumFrames / _duration;
+    }
+    else
+    {
+        ofLogWarning("VideoDecoder::load") << "Unknown frame rate, assuming 30 fps: " << path;
+        _frameRate = 30;
+    }
+
+    if (_isCacheEnabled && _totalNumFrames > 0 && _duration > 0)
+    {
+        std::size_t bytes = _totalNumFrames * ofPixels::bytesFromPixelFormat(_width, _height, _pixelFormat);
+
+        if (reserveCache(bytes))
+        {
+            _cache.resize(_totalNumFrames);
+            _cacheBytes = bytes;
+            _isCached = true;
+        }
+        else
+        {
+            ofLogNotice("VideoDecoder::load") << "Clip exceeds the cache budget, streaming: " << path;
+        }
+    }
+
+    _quad.clear();
+    _quad.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
+    _quad.addVertex(ofVec3f(0, 0));
+    _quad.addTexCoord(ofVec2f(0, 0));
+    _quad.addVertex(ofVec3f(_width, 0));
+    _quad.addTexCoord(ofVec2f(_width, 0));
+    _quad.addVertex(ofVec3f(0, _height));
+    _quad.addTexCoord(ofVec2f(0, _height));
+    _quad.addVertex(ofVec3f(_width, _height));
+    _quad.addTexCoord(ofVec2f(_width, _height));
+
+    _cachedFrames = 0;
+    _cacheFrameIndex = -1;
+    _frames.reset();
+    _isFrameNew = false;
+    _isLoaded = true;
+
+    startThread();
+
+    return true;
+}
+
+
+void VideoDecoder::close()
+{
+    if (isThreadRunning())
+    {
+        waitForThread(true);
+    }
+
+    if (_isLoaded)
+    {
+        _player.close();
+        _textures.clear();
+
+        if (_isCached)
+        {
+            releaseCache(_cacheBytes);
+            _cache.clear();
+            _cacheBytes = 0;
+            _isCached = false;
+        }
+
+        _isLoaded = false;
+    }
+}
+
+
+void VideoDecoder::setCacheEnabled(bool cacheEnabled)
+{
+    _isCacheEnabled = cacheEnabled;
+}
+
+
+bool VideoDecoder::isCacheEnabled() const
+{
+    return _isCacheEnabled;
+}
+
+
+bool VideoDecoder::isCached() const
+{
+    return _isCached;
+}
+
+
+bool VideoDecoder::isLoaded() const
+{
+    return _isLoaded;
+}
+
+
+void VideoDecoder::update(double time)
+{
+    _isFrameNew = false;
+
+    if (!_isLoaded)
+    {
+        return;
+    }
+
+    if (_isCached)
+    {
+        // Cached clips are indexed directly, so looping needs no seek.
+        std::size_t frameIndex = getCacheFrameIndex(time);
+
+        if (static_cast<int>(frameIndex) != _cacheFrameIndex &&
+            frameIndex < _cachedFrames.load(std::memory_order_acquire))
+        {
+            _uploader.upload(_cache[frameIndex], _textures);
+            _cacheFrameIndex = frameIndex;
+            _isFrameNew = true;
+        }
+
+        return;
+    }
+
+    const ofPixels* dueFrame = _frames.acquire(time, _duration);
+
+    if (dueFrame)
+    {
+        _uploader.upload(*dueFrame, _textures);
+        _isFrameNew = true;
+    }
+
+    // Hand the released slots back to the decoder thread.
+    _frames.release();
+}
+
+
+bool VideoDecoder::isFrameNew() const
+{
+    return _isFrameNew;
+}
+
+
+void VideoDecoder::seek(double time)
+{
+    _frames.seek(time);
+}
+
+
+bool VideoDecoder::preroll()
+{
+    _isFrameNew = false;
+
+    if (_isCached)
+    {
+        return getCacheFrameIndex(_frames.getSeekTime()) < _cachedFrames.load(std::memory_order_acquire);
+    }
+
+    return _frames.preroll();
+}
+
+
+float VideoDecoder::getWidth() const
+{
+    return _width;
+}
+
+
+float VideoDecoder::getHeight() const
+{
+    return _height;
+}
+
+
+double VideoDecoder::getDuration() const
+{
+    return _duration;
+}
+
+
+double VideoDecoder::getFrameRate() const
+{
+    return _frameRate;
+}
+
+
+void VideoDecoder::setDownscale(int level)
+{
+    _downscale.store(ofClamp(level, 0, MAX_DOWNSCALE), std::memory_order_relaxed);
+}
+
+
+int VideoDecoder::getDownscale() const
+{
+    return _isCached ? 0 : _downscale.load(std::memory_order_relaxed);
+}
+
+
+const TextureUploader::Stats& VideoDecoder::getUploadStats() const
+{
+    return _uploader.getStats();
+}
+
+
+void VideoDecoder::setColorMatrix(ColorMatrix colorMatrix)
+{
+    _colorMatrix = colorMatrix;
+}
+
+
+VideoDecoder::ColorMatrix VideoDecoder::getColorMatrix() const
+{
+    return _colorMatrix;
+}
+
+
+ofPixelFormat VideoDecoder::getPixelFormat() const
+{
+    return _pixelFormat;
+}
+
+
+const ofTexture& VideoDecoder::getTexture() const
+{
+    static const ofTexture empty;
+    return _textures.empty() ? empty : _textures[0];
+}
+
+
+void VideoDecoder::setShaderUniforms(const ofShader& shader) const
+{
+    int pixelFormat = 0;
+
+    // Bound here too so that layers can draw the frame with their own mesh.
+    if (!_textures.empty() && _textures[0].isAllocated())
+    {
+        shader.setUniformTexture("tex0", _textures[0], 0);
+    }
+
+    if (_textures.size() == 2)
+    {
+        pixelFormat = 1;
+        shader.setUniformTexture("uvTex", _textures[1], 2);
+    }
+    else if (_textures.size() == 3)
+    {
+        pixelFormat = 2;
+        shader.setUniformTexture("uvTex", _textures[1], 2);
+        shader.setUniformTexture("vTex", _textures[2], 3);
+    }
+
+    ColorMatrix colorMatrix = _colorMatrix;
+
+    if (colorMatrix == COLOR_MATRIX_AUTO)
+    {
+        colorMatrix = _height >= 720 ? COLOR_MATRIX_BT709 : COLOR_MATRIX_BT601;
+    }
+
+    shader.setUniform1i("pixelFormat", pixelFormat);
+    shader.setUniform1i("colorMatrix", colorMatrix == COLOR_MATRIX_BT709 ? 1 : 0);
+
+    // Layers sample in full size pixels, map them to the decoded size.
+    if (!_textures.empty() && _textures[0].isAllocated() && _width > 0 && _height > 0)
+    {
+        shader.setUniform2f("sourceScale",
+                            _textures[0].getWidth() / _width,
+                            _textures[0].getHeight() / _height);
+    }
+    else
+    {
+        shader.setUniform2f("sourceScale", 1, 1);
+    }
+
+    // Rectangle textures are sampled in pixels, so map luma to chroma pixels.
+    if (_textures.size() > 1 && _textures[0].isAllocated())
+    {
+        shader.setUniform2f("chromaScale",
+                            _textures[1].getWidth() / _textures[0].getWidth(),
+                            _textures[1].getHeight() / _textures[0].getHeight());
+    }
+    else
+    {
+        shader.setUniform2f("chromaScale", 1, 1);
+    }
+}
+
+
+void VideoDecoder::draw(float x, float y) const
+{
+    const ofTexture& texture = getTexture();
+
+    if (texture.isAllocated())
+    {
+        ofPushMatrix();
+        ofTranslate(x, y);
+        texture.bind();
+        _quad.draw();
+        texture.unbind();
+        ofPopMatrix();
+    }
+}
+
+
+void VideoDecoder::threadedFunction()
+{
+    int frameIndex = 0;
+    bool step = false;
+
+    if (_isCached)
+    {
+        fillCache();
+        return;
+    }
+
+    while (isThreadRunning())
+    {
+        double seekTime = 0;
+
+        if (_frames.pollSeek(seekTime))
+        {
+            frameIndex = static_cast<int>(seekTime * _frameRate);
+
+            if (_totalNumFrames > 0)
+            {
+                frameIndex %= _totalNumFrames;
+            }
+
+            _player.setFrame(frameIndex);
+            step = false;
+        }
+
+        ofPixels* pixels = _frames.getWriteFrame();
+
+        if (!pixels)
+        {
+            // The render thread is far enough behind.
+            sleep(1);
+            continue;
+        }
+
+        if (step)
+        {
+            if (frameIndex + 1 >= _totalNumFrames)
+            {
+                frameIndex = 0;
+                _player.firstFrame();
+            }
+            else
+            {
+                ++frameIndex;
+                _player.nextFrame();
+            }
+        }
+
+        step = true;
+
+        waitForFrame();
+
+        int level = _downscale.load(std::memory_order_relaxed);
+
+        if (0 == level || !downscale(_player.getPixels(), *pixels, level))
+        {
+            *pixels = _player.getPixels();
+        }
+
+        _frames.commit(frameIndex / _frameRate);
+    }
+}
+
+
+void VideoDecoder::fillCache()
+{
+    _player.firstFrame();
+
+    for (std::size_t i = 0; i < _cache.size() && isThreadRunning(); ++i)
+    {
+        if (i > 0)
+        {
+            _player.nextFrame();
+        }
+
+        waitForFrame();
+
+        _cache[i] = _player.getPixels();
+        _cachedFrames.store(i + 1, std::memory_order_release);
+    }
+}
+
+
+void VideoDecoder::waitForFrame()
+{
+    for (int i = 0; i < MAX_DECODE_RETRIES; ++i)
+    {
+        _player.update();
+
+        if (_player.isFrameNew())
+        {
+            break;
+        }
+
+        sleep(1);
+    }
+}
+
+
+std::size_t VideoDecoder::getCacheFrameIndex(double time) const
+{
+    return static_cast<std::size_t>(std::fmod(time, _duration) * _frameRate) % _cache.size();
+}
+
+
+bool VideoDecoder::reserveCache(std::size_t bytes)
+{
+    std::size_t usage = _cacheUsage.load();
+
+    do
+    {
+        if (usage + bytes > _cacheBudget.load())
+        {
+            return false;
+        }
+    }
+    while (!_cacheUsage.compare_exchange_weak(usage, usage + bytes));
+
+    return true;
+}
+
+
+void VideoDecoder::releaseCache(std::size_t bytes)
+{
+    _cacheUsage -= bytes;
+}
+
+
+void VideoDecoder::setCacheBudget(std::size_t bytes)
+{
+    _cacheBudget = bytes;
+}
+
+
+std::size_t VideoDecoder::getCacheBudget()
+{
+    return _cacheBudget;
+}
+
+
+std::size_t VideoDecoder::getCacheUsage()
+{
+    return _cacheUsage;
+}
+
+
+bool VideoDecoder::downscale(const ofPixels& source, ofPixels& target, int level)
+{
+    std::size_t factor = std::size_t(1) << level;
+    std::size_t width = source.getWidth() / factor;
+    std::size_t height = source.getHeight() / factor;
+
+    std::vector<TextureUploader::Plane> sourcePlanes = TextureUploader::getPlanes(source);
+
+    if (sourcePlanes.empty() || width < 2 || height < 2)
+    {
+        return false;
+    }
+
+    if (target.getWidth() != width ||
+        target.getHeight() != height ||
+        target.getPixelFormat() != source.getPixelFormat())
+    {
+        target.allocate(width, height, source.getPixelFormat());
+    }
+
+    std::vector<TextureUploader::Plane> targetPlanes = TextureUploader::getPlanes(target);
+
+    const unsigned char* sourceData = source.getData();
+    unsigned char* targetData = target.getData();
+
+    for (std::size_t i = 0; i < sourcePlanes.size(); ++i)
+    {
+        const TextureUploader::Plane& from = sourcePlanes[i];
+        const TextureUploader::Plane& to = targetPlanes[i];
+
+        std::size_t channels = ofGetNumChannelsFromGLFormat(from.glFormat);
+        std::size_t sourceStride = from.width * channels;
+        std::size_t area = factor * factor;
+
+        // A box filter over whole blocks, like the next mipmap levels.
+        for (int y = 0; y < to.height; ++y)
+        {
+            unsigned char* out = targetData + to.offset + y * to.width * channels;
+
+            for (int x = 0; x < to.width; ++x)
+            {
+                for (std::size_t c = 0; c < channels; ++c)
+                {
+                    std::size_t sum = 0;
+
+                    for (std::size_t v = 0; v < factor; ++v)
+                    {
+                        // Odd sizes round chroma up, so clamp to the plane.
+                        std::size_t row = std::min<std::size_t>(y * factor + v, from.height - 1);
+                        const unsigned char* in = sourceData + from.offset + row * sourceStride + c;
+
+                        for (std::size_t u = 0; u < factor; ++u)
+                        {
+                            std::size_t column = std::min<std::size_t>(x * factor + u, from.width - 1);
+                            sum += in[column * channels];
+                        }
+                    }
+
+                    *out++ = sum / area;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool VideoDecoder::loadWithPreferredPixelFormat(const std::string& path)
+{
+    // Planar YUV is 12 bits per pixel instead of 24.
+    const ofPixelFormat pixelFormats[] = {
+        OF_PIXELS_NV12,
+        OF_PIXELS_I420,
+        OF_PIXELS_RGB
+    };
+
+    for (ofPixelFormat pixelFormat: pixelFormats)
+    {
+        if (!_player.setPixelFormat(pixelFormat))
+        {
+            continue;
+        }
+
+        if (_player.load(path))
+        {
+            return true;
+        }
+
+        _player.close();
+    }
+
+    return false;
+}
+
+
+} // namespace Kibio
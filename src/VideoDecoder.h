@@ -0,0 +1,291 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <atomic>
+#include "ofThread.h"
+#include "ofVideoPlayer.h"
+#include "ofMesh.h"
+#include "ofTexture.h"
+#include "ofShader.h"
+#include "FrameRing.h"
+#include "TextureUploader.h"
+#include "VideoSource.h"
+
+
+namespace Kibio {
+
+
+/// \brief Decodes a video on a background thread.
+///
+/// The decoder thread steps through the video frame by frame and decodes
+/// ahead into a FrameRing of timestamped frames. The render thread calls
+/// update() once per frame with the current playback time and only uploads
+/// the frame that is due.
+///
+/// When the platform player supports it, frames are decoded as planar YUV
+/// (NV12 or I420) and converted to RGB in the layer shader. This halves the
+/// bytes uploaded per frame compared to RGB.
+///
+/// Streamed frames can be decoded at a reduced resolution for layers that
+/// are small on screen. The decoder thread averages the planes down, so the
+/// upload and the sampled texture shrink, and small layers no longer alias.
+///
+/// Short clips can be cached. A cached clip is decoded once into memory and
+/// then played back by frame index without any decoding or seeking, so the
+/// loop point is seamless. All caches share one memory budget and clips that
+/// do not fit are streamed instead.
+class VideoDecoder: public ofThread, public VideoSource
+{
+public:
+    /// \brief A typedef for a shared decoder.
+    typedef std::shared_ptr<VideoDecoder> SharedPtr;
+
+    /// \brief Create a VideoDecoder.
+    VideoDecoder();
+
+    /// \brief Destroy the VideoDecoder, stopping the decoder thread.
+    virtual ~VideoDecoder();
+
+    /// \brief Enable caching of the decoded clip.
+    ///
+    /// Must be called before load().
+    ///
+    /// \param cacheEnabled true to cache the clip if it fits the budget.
+    void setCacheEnabled(bool cacheEnabled);
+
+    /// \returns true if caching was requested.
+    bool isCacheEnabled() const;
+
+    /// \returns true if the loaded clip is played from the cache.
+    bool isCached() const;
+
+    /// \brief Load a video and start decoding.
+    /// \param path The path to the video file.
+    /// \returns true if loaded successfully.
+    bool load(const std::string& path) override;
+
+    /// \brief Stop decoding and close the video.
+    void close() override;
+
+    /// \returns true if a video is loaded.
+    bool isLoaded() const override;
+
+    /// \brief Select the frame due at the given time and upload it.
+    ///
+    /// Must be called from the thread that owns the GL context. Frames that
+    /// are already late are dropped and the current frame is held until the
+    /// next frame is due.
+    ///
+    /// \param time The playback time in seconds.
+    void update(double time) override;
+
+    /// \returns true if the last call to update() uploaded a new frame.
+    bool isFrameNew() const override;
+
+    /// \brief Restart decoding from the given time.
+    ///
+    /// Frames decoded before the seek are discarded by the render thread.
+    ///
+    /// \param time The time in seconds to seek to.
+    void seek(double time) override;
+
+    /// \brief Discard frames decoded before the last seek.
+    ///
+    /// Keeps the current frame and frees ring slots for the decoder thread.
+    /// Call instead of update() while waiting for a seek to complete.
+    ///
+    /// \returns true if a frame decoded after the last seek is ready.
+    bool preroll() override;
+
+    /// \returns the video width in pixels.
+    float getWidth() const override;
+
+    /// \returns the video height in pixels.
+    float getHeight() const override;
+
+    /// \returns the video duration in seconds.
+    double getDuration() const override;
+
+    /// \returns the video frame rate in frames per second.
+    double getFrameRate() const override;
+
+    /// \brief Request frames at a reduced resolution.
+    ///
+    /// Takes effect with the next decoded frame. Cached clips are always
+    /// played at full resolution.
+    ///
+    /// \param level The number of times the resolution is halved.
+    void setDownscale(int level) override;
+
+    /// \returns the number of times the resolution is halved.
+    int getDownscale() const override;
+
+    /// \returns the upload timing statistics.
+    const TextureUploader::Stats& getUploadStats() const override;
+
+    /// \brief Set the YUV to RGB conversion matrix.
+    /// \param colorMatrix The conversion matrix.
+    void setColorMatrix(ColorMatrix colorMatrix) override;
+
+    /// \returns the YUV to RGB conversion matrix.
+    ColorMatrix getColorMatrix() const;
+
+    /// \returns the decoded pixel format.
+    ofPixelFormat getPixelFormat() const;
+
+    /// \returns the texture holding the current frame, or its luma plane.
+    const ofTexture& getTexture() const;
+
+    /// \brief Set the uniforms needed to sample the current frame.
+    ///
+    /// Binds the frame, or its luma plane, to texture unit 0 and the chroma
+    /// planes of planar frames to texture units 2 and 3. Downscaled frames
+    /// set `sourceScale` below 1. Must be called while the shader is bound.
+    ///
+    /// \param shader The shader to configure.
+    void setShaderUniforms(const ofShader& shader) const override;
+
+    /// \brief Draw the current frame.
+    ///
+    /// Planar or downscaled frames are drawn with texture coordinates in full
+    /// size pixels and need a shader configured with setShaderUniforms().
+    ///
+    /// \param x The x position.
+    /// \param y The y position.
+    void draw(float x, float y) const override;
+
+    /// \brief Set the memory budget shared by all clip caches.
+    /// \param bytes The budget in bytes.
+    static void setCacheBudget(std::size_t bytes);
+
+    /// \returns the memory budget shared by all clip caches in bytes.
+    static std::size_t getCacheBudget();
+
+    /// \returns the bytes currently reserved by clip caches.
+    static std::size_t getCacheUsage();
+
+    enum
+    {
+        /// \brief The number of frames decoded ahead.
+        RING_SIZE = 4,
+        /// \brief The number of updates to wait for a stepped frame.
+        MAX_DECODE_RETRIES = 10
+    };
+
+protected:
+    void threadedFunction() override;
+
+private:
+    /// \brief Decode every frame of the clip into the cache.
+    void fillCache();
+
+    /// \brief Update the player until the stepped frame is decoded.
+    void waitForFrame();
+
+    /// \brief Get the cache frame due at a playback time.
+    /// \param time The playback time in seconds.
+    /// \returns the cache frame index, wrapped to the clip length.
+    std::size_t getCacheFrameIndex(double time) const;
+
+    /// \brief Reserve bytes from the shared cache budget.
+    /// \param bytes The number of bytes to reserve.
+    /// \returns true if the bytes fit the budget.
+    static bool reserveCache(std::size_t bytes);
+
+    /// \brief Return bytes to the shared cache budget.
+    /// \param bytes The number of bytes to release.
+    static void releaseCache(std::size_t bytes);
+
+    /// \brief Average every plane of a frame down by a power of two.
+    /// \param source The full size frame.
+    /// \param target The downscaled frame.
+    /// \param level The number of times the resolution is halved.
+    /// \returns false if the pixel format can not be downscaled.
+    static bool downscale(const ofPixels& source, ofPixels& target, int level);
+
+    /// \brief Try to load the video with each pixel format in turn.
+    /// \param path The path to the video file.
+    /// \returns true if loaded successfully.
+    bool loadWithPreferredPixelFormat(const std::string& path);
+
+    /// \brief The video player, only touched by the decoder thread once loaded.
+    ofVideoPlayer _player;
+
+    /// \brief The textures holding the planes of the current frame.
+    std::vector<ofTexture> _textures;
+
+    /// \brief Streams due frames into the textures.
+    TextureUploader _uploader;
+
+    /// \brief The frames decoded ahead.
+    FrameRing<ofPixels, RING_SIZE> _frames;
+
+    /// \brief Every decoded frame of a cached clip, in frame order.
+    std::vector<ofPixels> _cache;
+
+    /// \brief The number of leading cache frames decoded so far.
+    std::atomic<std::size_t> _cachedFrames;
+
+    /// \brief The bytes reserved from the cache budget.
+    std::size_t _cacheBytes;
+
+    /// \brief The cache frame index currently uploaded.
+    int _cacheFrameIndex;
+
+    /// \brief The requested downscale level, read by the decoder thread.
+    std::atomic<int> _downscale;
+
+    /// \brief A quad the size of the video with texture coordinates in pixels.
+    ofMesh _quad;
+
+    /// \brief The memory budget shared by all clip caches in bytes.
+    static std::atomic<std::size_t> _cacheBudget;
+
+    /// \brief The bytes reserved by all clip caches.
+    static std::atomic<std::size_t> _cacheUsage;
+
+    bool _isCacheEnabled;
+    bool _isCached;
+
+    bool _isLoaded;
+    bool _isFrameNew;
+
+    float _width;
+    float _height;
+    double _duration;
+    double _frameRate;
+    int _totalNumFrames;
+
+    ofPixelFormat _pixelFormat;
+    ColorMatrix _colorMatrix;
+
+};
+
+
+} // namespace Kibio
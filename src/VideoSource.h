@@ -0,0 +1,162 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include "ofShader.h"
+#include "TextureUploader.h"
+
+
+namespace Kibio {
+
+
+/// \brief An abstract source of timestamped video frames for a layer.
+///
+/// A source uploads the frame due at the playback time passed to update()
+/// and draws it with texture coordinates in pixels. Sources that do not
+/// store RGB textures convert their frames in the layer shader, configured
+/// with setShaderUniforms().
+class VideoSource
+{
+public:
+    /// \brief A typedef for a shared source.
+    typedef std::shared_ptr<VideoSource> SharedPtr;
+
+    /// \brief The YUV to RGB conversion matrix.
+    enum ColorMatrix
+    {
+        /// \brief BT.709 for HD content and BT.601 otherwise.
+        COLOR_MATRIX_AUTO,
+        /// \brief ITU-R BT.601, standard definition.
+        COLOR_MATRIX_BT601,
+        /// \brief ITU-R BT.709, high definition.
+        COLOR_MATRIX_BT709
+    };
+
+    virtual ~VideoSource()
+    {
+    }
+
+    /// \brief Load a video and start decoding.
+    /// \param path The path to the video file.
+    /// \returns true if loaded successfully.
+    virtual bool load(const std::string& path) = 0;
+
+    /// \brief Stop decoding and close the video.
+    virtual void close() = 0;
+
+    /// \returns true if a video is loaded.
+    virtual bool isLoaded() const = 0;
+
+    /// \brief Select the frame due at the given time and upload it.
+    ///
+    /// Must be called from the thread that owns the GL context.
+    ///
+    /// \param time The playback time in seconds.
+    virtual void update(double time) = 0;
+
+    /// \returns true if the last call to update() uploaded a new frame.
+    virtual bool isFrameNew() const = 0;
+
+    /// \brief Restart decoding from the given time.
+    /// \param time The time in seconds to seek to.
+    virtual void seek(double time) = 0;
+
+    /// \brief Discard frames decoded before the last seek.
+    ///
+    /// Call instead of update() while waiting for a seek to complete.
+    ///
+    /// \returns true if a frame decoded after the last seek is ready.
+    virtual bool preroll() = 0;
+
+    /// \returns the video width in pixels.
+    virtual float getWidth() const = 0;
+
+    /// \returns the video height in pixels.
+    virtual float getHeight() const = 0;
+
+    /// \returns the video duration in seconds.
+    virtual double getDuration() const = 0;
+
+    /// \returns the video frame rate in frames per second.
+    virtual double getFrameRate() const = 0;
+
+    /// \brief Set the YUV to RGB conversion matrix.
+    ///
+    /// Sources that do not decode to YUV ignore the matrix.
+    ///
+    /// \param colorMatrix The conversion matrix.
+    virtual void setColorMatrix(ColorMatrix colorMatrix)
+    {
+    }
+
+    /// \brief Request frames at a reduced resolution.
+    ///
+    /// Sources that cannot decode at a reduced resolution ignore the
+    /// request. Frames are still drawn and sampled in full size pixels,
+    /// setShaderUniforms() maps them to the smaller textures.
+    ///
+    /// \param level The number of times the resolution is halved, clamped
+    ///     to MAX_DOWNSCALE.
+    virtual void setDownscale(int level)
+    {
+    }
+
+    /// \returns the number of times the resolution is halved.
+    virtual int getDownscale() const
+    {
+        return 0;
+    }
+
+    enum
+    {
+        /// \brief The largest downscale level.
+        MAX_DOWNSCALE = 3
+    };
+
+    /// \returns the upload timing statistics.
+    virtual const TextureUploader::Stats& getUploadStats() const = 0;
+
+    /// \brief Set the uniforms needed to sample the current frame.
+    ///
+    /// Binds every texture the shader samples, so that the frame can also be
+    /// drawn with any mesh that has texture coordinates in pixels. Sets
+    /// `sourceScale` to map those pixels to the frame textures. Must be
+    /// called while the shader is bound.
+    ///
+    /// \param shader The shader to configure.
+    virtual void setShaderUniforms(const ofShader& shader) const = 0;
+
+    /// \brief Draw the current frame.
+    /// \param x The x position.
+    /// \param y The y position.
+    virtual void draw(float x, float y) const = 0;
+
+};
+
+
+} // namespace Kibio
@@ -0,0 +1,253 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#include "WarpMesh.h"
+#include "ofLog.h"
+
+
+namespace Kibio {
+
+
+WarpMesh::WarpMesh():
+    _mode(MODE_PERSPECTIVE),
+    _resolution(DEFAULT_RESOLUTION),
+    _isDirty(true)
+{
+    _mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    _mesh.setUsage(GL_STATIC_DRAW);
+    resetControlPoints();
+}
+
+
+void WarpMesh::setMode(Mode mode)
+{
+    if (mode != _mode)
+    {
+        _mode = mode;
+        _isDirty = true;
+    }
+}
+
+
+WarpMesh::Mode WarpMesh::getMode() const
+{
+    return _mode;
+}
+
+
+void WarpMesh::setResolution(std::size_t resolution)
+{
+    resolution = std::max(std::size_t(1), std::min(std::size_t(MAX_RESOLUTION), resolution));
+
+    if (resolution != _resolution)
+    {
+        _resolution = resolution;
+        _isDirty = true;
+    }
+}
+
+
+std::size_t WarpMesh::getResolution() const
+{
+    return _resolution;
+}
+
+
+void WarpMesh::setControlPoint(std::size_t column, std::size_t row, const ofPoint& point)
+{
+    _controlPoints[row * LATTICE_SIZE + column] = point;
+    _isDirty = true;
+}
+
+
+const ofPoint& WarpMesh::getControlPoint(std::size_t column, std::size_t row) const
+{
+    return _controlPoints[row * LATTICE_SIZE + column];
+}
+
+
+void WarpMesh::resetControlPoints()
+{
+    for (std::size_t row = 0; row < LATTICE_SIZE; ++row)
+    {
+        for (std::size_t column = 0; column < LATTICE_SIZE; ++column)
+        {
+            _controlPoints[row * LATTICE_SIZE + column] = ofPoint(float(column) / (LATTICE_SIZE - 1),
+                                                                  float(row) / (LATTICE_SIZE - 1));
+        }
+    }
+
+    _isDirty = true;
+}
+
+
+bool WarpMesh::update(float width, float height)
+{
+    return update(ofRectangle(0, 0, width, height));
+}
+
+
+bool WarpMesh::update(const ofRectangle& source)
+{
+    if (!_isDirty && source == _source)
+    {
+        return false;
+    }
+
+    _source = source;
+    _isDirty = false;
+
+    float width = source.getWidth();
+    float height = source.getHeight();
+
+    // A flat quad needs no subdivision, the homography is exact.
+    std::size_t resolution = _mode == MODE_BEZIER ? _resolution : 1;
+
+    _mesh.clear();
+
+    for (std::size_t row = 0; row <= resolution; ++row)
+    {
+        for (std::size_t column = 0; column <= resolution; ++column)
+        {
+            float u = float(column) / resolution;
+            float v = float(row) / resolution;
+
+            ofPoint position = _mode == MODE_BEZIER ? evaluate(u, v) : ofPoint(u, v);
+
+            _mesh.addVertex(ofPoint(position.x * width, position.y * height));
+            _mesh.addTexCoord(ofVec2f(source.getX() + u * width,
+                                      source.getY() + v * height));
+        }
+    }
+
+    for (std::size_t row = 0; row < resolution; ++row)
+    {
+        for (std::size_t column = 0; column < resolution; ++column)
+        {
+            ofIndexType topLeft = row * (resolution + 1) + column;
+            ofIndexType topRight = topLeft + 1;
+            ofIndexType bottomLeft = topLeft + resolution + 1;
+            ofIndexType bottomRight = bottomLeft + 1;
+
+            _mesh.addTriangle(topLeft, topRight, bottomLeft);
+            _mesh.addTriangle(topRight, bottomRight, bottomLeft);
+        }
+    }
+
+    return true;
+}
+
+
+void WarpMesh::draw() const
+{
+    _mesh.draw();
+}
+
+
+void WarpMesh::drawInstanced(std::size_t count) const
+{
+    _mesh.drawInstanced(OF_MESH_FILL, count);
+}
+
+
+Json::Value WarpMesh::toJSON(const WarpMesh& object)
+{
+    Json::Value json;
+
+    json["mode"] = object._mode == MODE_BEZIER ? "bezier" : "perspective";
+    json["resolution"] = Json::UInt(object._resolution);
+
+    for (std::size_t i = 0; i < LATTICE_SIZE * LATTICE_SIZE; ++i)
+    {
+        Json::Value point;
+        point["x"] = object._controlPoints[i].x;
+        point["y"] = object._controlPoints[i].y;
+        json["lattice"].append(point);
+    }
+
+    return json;
+}
+
+
+bool WarpMesh::fromJSON(const Json::Value& json, WarpMesh& object)
+{
+    object.setMode(json.get("mode", "perspective").asString() == "bezier" ? MODE_BEZIER : MODE_PERSPECTIVE);
+    object.setResolution(json.get("resolution", DEFAULT_RESOLUTION).asUInt());
+    object.resetControlPoints();
+
+    if (json.isMember("lattice"))
+    {
+        const Json::Value& lattice = json["lattice"];
+
+        if (LATTICE_SIZE * LATTICE_SIZE != lattice.size())
+        {
+            ofLogWarning("WarpMesh::fromJSON") << "Invalid lattice size: " << lattice.size();
+            return false;
+        }
+
+        for (Json::ArrayIndex i = 0; i < lattice.size(); ++i)
+        {
+            object._controlPoints[i] = ofPoint(lattice[i].get("x", 0).asFloat(),
+                                               lattice[i].get("y", 0).asFloat());
+        }
+    }
+
+    return true;
+}
+
+
+ofPoint WarpMesh::evaluate(float u, float v) const
+{
+    // Cubic Bernstein polynomials.
+    float bu[LATTICE_SIZE] = {
+        (1 - u) * (1 - u) * (1 - u),
+        3 * u * (1 - u) * (1 - u),
+        3 * u * u * (1 - u),
+        u * u * u
+    };
+
+    float bv[LATTICE_SIZE] = {
+        (1 - v) * (1 - v) * (1 - v),
+        3 * v * (1 - v) * (1 - v),
+        3 * v * v * (1 - v),
+        v * v * v
+    };
+
+    ofPoint point;
+
+    for (std::size_t row = 0; row < LATTICE_SIZE; ++row)
+    {
+        for (std::size_t column = 0; column < LATTICE_SIZE; ++column)
+        {
+            point += _controlPoints[row * LATTICE_SIZE + column] * (bu[column] * bv[row]);
+        }
+    }
+
+    return point;
+}
+
+
+} // namespace Kibio
@@ -0,0 +1,165 @@
+// =============================================================================
+//
+// Copyright (c) 2014-2015 Christopher Baker <http://christopherbaker.net>
+//               2015 Brannon Dorsey <http://brannondorsey.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// =============================================================================
+
+
+#pragma once
+
+
+#include <json/json.h>
+#include "ofRectangle.h"
+#include "ofVboMesh.h"
+
+
+namespace Kibio {
+
+
+/// \brief A subdivided grid that carries a layer through its warp.
+///
+/// The grid spans the layer in layer space, with texture coordinates in
+/// pixels, and is drawn under the layer homography. The GPU interpolates
+/// the homography per pixel, so the result is perspective correct, and the
+/// quad corners stay under the control of the quad warper.
+///
+/// In Bézier mode the grid is bent by a bicubic Bézier surface with a 4x4
+/// lattice of control points before the homography is applied, which maps a
+/// layer onto curved surfaces. Control points are normalized to the layer
+/// size, and the default lattice is flat.
+///
+/// The grid is kept in a static VBO and only rebuilt when the lattice,
+/// resolution or layer size changes.
+class WarpMesh
+{
+public:
+    /// \brief The warp modes.
+    enum Mode
+    {
+        /// \brief A planar quad, warped by the homography only.
+        MODE_PERSPECTIVE,
+        /// \brief A bicubic Bézier surface, warped by the homography.
+        MODE_BEZIER
+    };
+
+    /// \brief Create a flat WarpMesh.
+    WarpMesh();
+
+    /// \brief Set the warp mode.
+    /// \param mode The warp mode.
+    void setMode(Mode mode);
+
+    /// \returns the warp mode.
+    Mode getMode() const;
+
+    /// \brief Set the number of grid cells along each side in Bézier mode.
+    /// \param resolution The number of cells, clamped to 1 - MAX_RESOLUTION.
+    void setResolution(std::size_t resolution);
+
+    /// \returns the number of grid cells along each side in Bézier mode.
+    std::size_t getResolution() const;
+
+    /// \brief Set a lattice control point.
+    /// \param column The lattice column, 0 - 3.
+    /// \param row The lattice row, 0 - 3.
+    /// \param point The control point, normalized to the layer size.
+    void setControlPoint(std::size_t column, std::size_t row, const ofPoint& point);
+
+    /// \brief Get a lattice control point.
+    /// \param column The lattice column, 0 - 3.
+    /// \param row The lattice row, 0 - 3.
+    /// \returns the control point, normalized to the layer size.
+    const ofPoint& getControlPoint(std::size_t column, std::size_t row) const;
+
+    /// \brief Reset the lattice to a flat grid.
+    void resetControlPoints();
+
+    /// \brief Rebuild the grid if anything changed.
+    /// \param width The layer width in pixels.
+    /// \param height The layer height in pixels.
+    /// \returns true if the grid was rebuilt.
+    bool update(float width, float height);
+
+    /// \brief Rebuild the grid for a region of a texture if anything changed.
+    ///
+    /// The grid spans the size of the region at the origin and samples the
+    /// texture inside the region.
+    ///
+    /// \param source The region in texture pixels.
+    /// \returns true if the grid was rebuilt.
+    bool update(const ofRectangle& source);
+
+    /// \brief Draw the grid with the currently bound shader and textures.
+    void draw() const;
+
+    /// \brief Draw several instances of the grid in a single draw call.
+    /// \param count The number of instances.
+    void drawInstanced(std::size_t count) const;
+
+    /// \brief Save the object to JSON.
+    /// \brief The object to save.
+    /// \returns the object as JSON.
+    static Json::Value toJSON(const WarpMesh& object);
+
+    /// \brief Load the object from JSON.
+    /// \brief json The object as JSON.
+    /// \brief object The object to load from JSON.
+    /// \returns true iff deserialized successfully.
+    static bool fromJSON(const Json::Value& json, WarpMesh& object);
+
+    enum
+    {
+        /// \brief The number of lattice control points along each side.
+        LATTICE_SIZE = 4,
+        /// \brief The default number of grid cells along each side.
+        DEFAULT_RESOLUTION = 16,
+        /// \brief The maximum number of grid cells along each side.
+        MAX_RESOLUTION = 128
+    };
+
+private:
+    /// \brief Evaluate the Bézier surface.
+    /// \param u The normalized horizontal position.
+    /// \param v The normalized vertical position.
+    /// \returns the normalized surface position.
+    ofPoint evaluate(float u, float v) const;
+
+    /// \brief The grid.
+    ofVboMesh _mesh;
+
+    Mode _mode;
+
+    std::size_t _resolution;
+
+    /// \brief The control points, row by row.
+    ofPoint _controlPoints[LATTICE_SIZE * LATTICE_SIZE];
+
+    /// \brief The texture region the grid was built for.
+    ofRectangle _source;
+
+    /// \brief true if the grid must be rebuilt.
+    bool _isDirty;
+
+};
+
+
+} // namespace Kibio